@@ -0,0 +1,193 @@
+#include "bench_report.hpp"
+#include <spdlog/spdlog.h>
+#include <algorithm>
+#include <cmath>
+#include <string>
+#include <vector>
+
+// Compare two benchmark reports written with --json and flag regressions.
+//
+// A metric regresses when its median moved in the bad direction by more than
+// --threshold percent and, if both runs kept at least --min-samples samples,
+// a two-sided Mann-Whitney U test rejects "same distribution" at --alpha.
+// The rank test makes no normality assumption, which suits skewed latency
+// samples. Metrics with fewer samples are judged on the threshold alone.
+//
+// Exits 0 when nothing regressed, 2 when something did and 1 on errors, so a
+// deployment pipeline can gate on the exit code.
+//
+// Usage: bench_compare BASELINE CANDIDATE [--threshold PERCENT] [--alpha A] [--min-samples N]
+
+struct CompareOptions {
+    std::string baseline_path;
+    std::string candidate_path;
+    double threshold_percent = 5.0;
+    double alpha = 0.01;
+    size_t min_samples = 5;
+};
+
+struct MetricSamples {
+    std::string unit;
+    bool lower_is_better = true;
+    double median = 0.0;
+    std::vector<double> samples;
+};
+
+CompareOptions parseOptions(int argc, char** argv) {
+    CompareOptions options;
+    std::vector<std::string> paths;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg.rfind("--", 0) != 0) {
+            paths.push_back(arg);
+            continue;
+        }
+        if (i + 1 >= argc) {
+            throw std::invalid_argument("Missing value for " + arg);
+        }
+        std::string value = argv[++i];
+        if (arg == "--threshold") options.threshold_percent = std::stod(value);
+        else if (arg == "--alpha") options.alpha = std::stod(value);
+        else if (arg == "--min-samples") options.min_samples = std::stoul(value);
+        else throw std::invalid_argument("Unknown option: " + arg);
+    }
+    if (paths.size() != 2) {
+        throw std::invalid_argument(
+            "Usage: bench_compare BASELINE CANDIDATE [--threshold PERCENT] [--alpha A] [--min-samples N]");
+    }
+    options.baseline_path = paths[0];
+    options.candidate_path = paths[1];
+    return options;
+}
+
+std::vector<std::pair<std::string, MetricSamples>> readMetrics(const JsonValue& report) {
+    const JsonValue* metrics = report.find("metrics");
+    if (!metrics || metrics->type != JsonValue::Type::Object) {
+        throw std::runtime_error("Report has no metrics");
+    }
+    std::vector<std::pair<std::string, MetricSamples>> out;
+    for (const auto& [name, metric] : metrics->object) {
+        MetricSamples m;
+        m.unit = metric.stringOr("unit", "");
+        const JsonValue* lower = metric.find("lower_is_better");
+        m.lower_is_better = !lower || lower->type != JsonValue::Type::Bool || lower->boolean;
+        m.median = metric.numberOr("median", 0.0);
+        if (const JsonValue* samples = metric.find("samples")) {
+            for (const auto& sample : samples->array) {
+                if (sample.type == JsonValue::Type::Number) {
+                    m.samples.push_back(sample.number);
+                }
+            }
+        }
+        out.emplace_back(name, std::move(m));
+    }
+    return out;
+}
+
+// Two-sided p-value of the Mann-Whitney U test, normal approximation with
+// tie correction
+double mannWhitneyPValue(const std::vector<double>& a, const std::vector<double>& b) {
+    std::vector<std::pair<double, int>> all;
+    all.reserve(a.size() + b.size());
+    for (double v : a) all.emplace_back(v, 0);
+    for (double v : b) all.emplace_back(v, 1);
+    std::sort(all.begin(), all.end());
+
+    double rank_sum_a = 0.0;
+    double tie_term = 0.0;
+    for (size_t i = 0; i < all.size();) {
+        size_t j = i;
+        while (j < all.size() && all[j].first == all[i].first) {
+            ++j;
+        }
+        double rank = (i + 1 + j) / 2.0;  // average rank of the tied run
+        for (size_t k = i; k < j; ++k) {
+            if (all[k].second == 0) {
+                rank_sum_a += rank;
+            }
+        }
+        double t = static_cast<double>(j - i);
+        tie_term += t * t * t - t;
+        i = j;
+    }
+    double n1 = static_cast<double>(a.size());
+    double n2 = static_cast<double>(b.size());
+    double n = n1 + n2;
+    double u = rank_sum_a - n1 * (n1 + 1) / 2.0;
+    double mean = n1 * n2 / 2.0;
+    double variance = n1 * n2 / 12.0 * ((n + 1) - tie_term / (n * (n - 1)));
+    if (variance <= 0.0) {
+        return 1.0;  // every sample identical
+    }
+    double z = (std::abs(u - mean) - 0.5) / std::sqrt(variance);
+    return std::erfc(std::max(z, 0.0) / std::sqrt(2.0));
+}
+
+int main(int argc, char** argv) {
+    CompareOptions options;
+    try {
+        options = parseOptions(argc, argv);
+    } catch (const std::exception& e) {
+        spdlog::error("{}", e.what());
+        return 1;
+    }
+
+    try {
+        JsonValue baseline = readJsonFile(options.baseline_path);
+        JsonValue candidate = readJsonFile(options.candidate_path);
+        if (baseline.stringOr("benchmark", "") != candidate.stringOr("benchmark", "")) {
+            spdlog::warn("Comparing different benchmarks: {} vs {}", baseline.stringOr("benchmark", "?"),
+                         candidate.stringOr("benchmark", "?"));
+        }
+        const JsonValue* base_env = baseline.find("environment");
+        const JsonValue* cand_env = candidate.find("environment");
+        if (base_env && cand_env &&
+            (base_env->stringOr("cpu_model", "") != cand_env->stringOr("cpu_model", "") ||
+             base_env->stringOr("build_type", "") != cand_env->stringOr("build_type", ""))) {
+            spdlog::warn("Runs come from different CPUs or build types; differences may not be regressions");
+        }
+
+        auto base_metrics = readMetrics(baseline);
+        auto cand_metrics = readMetrics(candidate);
+        size_t regressions = 0, improvements = 0;
+        for (const auto& [name, base] : base_metrics) {
+            auto it = std::find_if(cand_metrics.begin(), cand_metrics.end(),
+                                   [&](const auto& m) { return m.first == name; });
+            if (it == cand_metrics.end()) {
+                spdlog::warn("{:<40} missing from candidate", name);
+                continue;
+            }
+            const MetricSamples& cand = it->second;
+            double change = (cand.median - base.median) * 100.0;
+            if (base.median != 0.0) {
+                change /= std::abs(base.median);
+            } else if (change != 0.0) {
+                change = std::copysign(HUGE_VAL, change);  // e.g. failures appearing where there were none
+            }
+            double worse = base.lower_is_better ? change : -change;
+
+            bool tested = base.samples.size() >= options.min_samples && cand.samples.size() >= options.min_samples;
+            double p = tested ? mannWhitneyPValue(base.samples, cand.samples) : 0.0;
+            bool significant = !tested || p < options.alpha;
+
+            const char* verdict = "";
+            if (std::abs(change) > options.threshold_percent && significant) {
+                if (worse > 0) {
+                    verdict = "REGRESSION";
+                    ++regressions;
+                } else {
+                    verdict = "improved";
+                    ++improvements;
+                }
+            }
+            spdlog::info("{:<40} {:>12.4g} -> {:>12.4g} {:<6} {:>+8.2f}%  {}  {}", name, base.median, cand.median,
+                         base.unit, change, tested ? fmt::format("p={:.2g}", p) : std::string("untested"), verdict);
+        }
+        spdlog::info("{} regressions, {} improvements (threshold {}%, alpha {})", regressions, improvements,
+                     options.threshold_percent, options.alpha);
+        return regressions > 0 ? 2 : 0;
+    } catch (const std::exception& e) {
+        spdlog::error("Comparison failed: {}", e.what());
+        return 1;
+    }
+}
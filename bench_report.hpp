@@ -0,0 +1,514 @@
+#ifndef BENCH_REPORT_HPP
+#define BENCH_REPORT_HPP
+
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <ctime>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+#include "cpu_info.hpp"
+#include "perf_counters.hpp"
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/utsname.h>
+#include <unistd.h>
+#endif
+
+// Machine-readable benchmark results.
+//
+// Every benchmark target fills one BenchReport and writes it with --json:
+//
+//   { "schema": "vector_store_bench/1", "benchmark": ..., "timestamp": ...,
+//     "environment": { host, os, compiler, build type, CPU model and flags },
+//     "dataset": { ... }, "parameters": { ... },
+//     "metrics": { name: { unit, lower_is_better, count, mean, stddev, min,
+//                          median, p90, p99, max, samples: [...] } } }
+//
+// Samples are kept so bench_compare can test whether two runs differ by more
+// than their noise. Metrics with many samples keep an evenly spaced quantile
+// sketch of kMaxStoredSamples values instead of every sample.
+
+constexpr const char* kBenchSchema = "vector_store_bench/1";
+constexpr size_t kMaxStoredSamples = 1000;
+
+namespace bench_detail {
+
+inline std::string jsonEscape(const std::string& text) {
+    std::string out = "\"";
+    for (char c : text) {
+        switch (c) {
+            case '"': out += "\\\""; break;
+            case '\\': out += "\\\\"; break;
+            case '\n': out += "\\n"; break;
+            case '\t': out += "\\t"; break;
+            default:
+                if (static_cast<unsigned char>(c) < 0x20) {
+                    char buffer[8];
+                    std::snprintf(buffer, sizeof(buffer), "\\u%04x", c);
+                    out += buffer;
+                } else {
+                    out += c;
+                }
+        }
+    }
+    return out + "\"";
+}
+
+inline std::string jsonNumber(double value) {
+    if (!std::isfinite(value)) {
+        return "null";
+    }
+    char buffer[32];
+    std::snprintf(buffer, sizeof(buffer), "%.17g", value);
+    return buffer;
+}
+
+inline std::string jsonValue(const std::string& value) { return jsonEscape(value); }
+inline std::string jsonValue(const char* value) { return jsonEscape(value); }
+inline std::string jsonValue(bool value) { return value ? "true" : "false"; }
+template <typename T>
+std::string jsonValue(T value) { return jsonNumber(static_cast<double>(value)); }
+
+inline std::string compilerName() {
+#if defined(__clang__)
+    return "clang " __clang_version__;
+#elif defined(__GNUC__)
+    return "gcc " __VERSION__;
+#elif defined(_MSC_VER)
+    return "msvc " + std::to_string(_MSC_VER);
+#else
+    return "unknown";
+#endif
+}
+
+}  // namespace bench_detail
+
+struct BenchMetricSummary {
+    size_t count = 0;
+    double mean = 0, stddev = 0, min = 0, median = 0, p90 = 0, p99 = 0, max = 0;
+};
+
+// Summary statistics of `samples`, which are sorted in place
+inline BenchMetricSummary summarizeSamples(std::vector<double>& samples) {
+    BenchMetricSummary summary;
+    summary.count = samples.size();
+    if (samples.empty()) {
+        return summary;
+    }
+    std::sort(samples.begin(), samples.end());
+    double sum = 0.0;
+    for (double s : samples) {
+        sum += s;
+    }
+    summary.mean = sum / samples.size();
+    double squares = 0.0;
+    for (double s : samples) {
+        squares += (s - summary.mean) * (s - summary.mean);
+    }
+    summary.stddev = samples.size() > 1 ? std::sqrt(squares / (samples.size() - 1)) : 0.0;
+    auto at = [&](double q) {
+        return samples[std::min(samples.size() - 1, static_cast<size_t>(q * samples.size()))];
+    };
+    summary.min = samples.front();
+    summary.median = at(0.5);
+    summary.p90 = at(0.9);
+    summary.p99 = at(0.99);
+    summary.max = samples.back();
+    return summary;
+}
+
+class BenchReport {
+private:
+    struct Metric {
+        std::string unit;
+        bool lower_is_better;
+        std::vector<double> samples;
+    };
+
+    std::string benchmark;
+    std::vector<std::pair<std::string, std::string>> dataset;     // key, JSON value
+    std::vector<std::pair<std::string, std::string>> parameters;  // key, JSON value
+    std::map<std::string, Metric> metrics;
+
+    static void set(std::vector<std::pair<std::string, std::string>>& fields,
+                    const std::string& key, std::string json) {
+        for (auto& field : fields) {
+            if (field.first == key) {
+                field.second = std::move(json);
+                return;
+            }
+        }
+        fields.emplace_back(key, std::move(json));
+    }
+
+    static void writeFields(std::ostream& out, const std::vector<std::pair<std::string, std::string>>& fields) {
+        out << "{";
+        for (size_t i = 0; i < fields.size(); ++i) {
+            out << (i ? ", " : "") << bench_detail::jsonEscape(fields[i].first) << ": " << fields[i].second;
+        }
+        out << "}";
+    }
+
+    static std::string timestamp() {
+        std::time_t now = std::chrono::system_clock::to_time_t(std::chrono::system_clock::now());
+        std::tm utc{};
+#if defined(_WIN32)
+        gmtime_s(&utc, &now);
+#else
+        gmtime_r(&now, &utc);
+#endif
+        char buffer[32];
+        std::strftime(buffer, sizeof(buffer), "%Y-%m-%dT%H:%M:%SZ", &utc);
+        return buffer;
+    }
+
+    void writeEnvironment(std::ostream& out) const {
+        std::vector<std::pair<std::string, std::string>> env;
+        std::string host = "unknown", os = "unknown", arch = "unknown";
+#if defined(__unix__) || defined(__APPLE__)
+        char name[256] = {};
+        if (gethostname(name, sizeof(name) - 1) == 0) {
+            host = name;
+        }
+        utsname uts{};
+        if (uname(&uts) == 0) {
+            os = std::string(uts.sysname) + " " + uts.release;
+            arch = uts.machine;
+        }
+#endif
+        env.emplace_back("hostname", bench_detail::jsonValue(host));
+        env.emplace_back("os", bench_detail::jsonValue(os));
+        env.emplace_back("arch", bench_detail::jsonValue(arch));
+        env.emplace_back("compiler", bench_detail::jsonValue(bench_detail::compilerName()));
+#ifdef NDEBUG
+        env.emplace_back("build_type", bench_detail::jsonValue("release"));
+#else
+        env.emplace_back("build_type", bench_detail::jsonValue("debug"));
+#endif
+        env.emplace_back("compiled_simd", bench_detail::jsonValue(compiledSimd()));
+        env.emplace_back("cpu_model", bench_detail::jsonValue(readCpuModel()));
+        env.emplace_back("logical_cpus", bench_detail::jsonValue(std::thread::hardware_concurrency()));
+        std::string flags = "[";
+        for (const auto& flag : detectCpuFlags()) {
+            flags += (flags.size() > 1 ? ", " : "") + bench_detail::jsonEscape(flag);
+        }
+        env.emplace_back("cpu_flags", flags + "]");
+        writeFields(out, env);
+    }
+
+public:
+    explicit BenchReport(const std::string& benchmark) : benchmark(benchmark) {}
+
+    // Describe the data the benchmark ran on (distribution, count, dimension, seed, ...)
+    template <typename T>
+    void setDataset(const std::string& key, const T& value) {
+        set(dataset, key, bench_detail::jsonValue(value));
+    }
+
+    // Record a run parameter (threads, rate, ...)
+    template <typename T>
+    void setParameter(const std::string& key, const T& value) {
+        set(parameters, key, bench_detail::jsonValue(value));
+    }
+
+    // Append measurements to a metric; repeated calls with the same name accumulate
+    void addSamples(const std::string& name, const std::string& unit, const std::vector<double>& samples,
+                    bool lower_is_better = true) {
+        Metric& metric = metrics.try_emplace(name, Metric{unit, lower_is_better, {}}).first->second;
+        metric.samples.insert(metric.samples.end(), samples.begin(), samples.end());
+    }
+
+    void addSample(const std::string& name, const std::string& unit, double value, bool lower_is_better = true) {
+        addSamples(name, unit, {value}, lower_is_better);
+    }
+
+    // Per-call hardware counter averages of each sampled query class, as
+    // "<prefix><class>.<event>_per_call" plus IPC
+    void addPerfCounters(const std::string& prefix, const std::vector<PerfClassSummary>& summaries) {
+        for (const auto& summary : summaries) {
+            if (summary.samples == 0) {
+                continue;
+            }
+            std::string name = prefix + perfQueryClassName(summary.query_class) + ".";
+            for (size_t e = 0; e < kPerfEventCount; ++e) {
+                if (summary.available[e]) {
+                    addSample(name + perfEventName(static_cast<PerfEvent>(e)) + "_per_call", "count",
+                              summary.perSample(static_cast<PerfEvent>(e)));
+                }
+            }
+            if (summary.available[static_cast<size_t>(PerfEvent::Instructions)]) {
+                addSample(name + "ipc", "instructions/cycle", summary.instructionsPerCycle(), false);
+            }
+        }
+    }
+
+    void write(std::ostream& out) const {
+        out << "{\n  \"schema\": " << bench_detail::jsonEscape(kBenchSchema)
+            << ",\n  \"benchmark\": " << bench_detail::jsonEscape(benchmark)
+            << ",\n  \"timestamp\": " << bench_detail::jsonEscape(timestamp())
+            << ",\n  \"environment\": ";
+        writeEnvironment(out);
+        out << ",\n  \"dataset\": ";
+        writeFields(out, dataset);
+        out << ",\n  \"parameters\": ";
+        writeFields(out, parameters);
+        out << ",\n  \"metrics\": {";
+        bool first = true;
+        for (const auto& [name, metric] : metrics) {
+            std::vector<double> sorted = metric.samples;
+            BenchMetricSummary s = summarizeSamples(sorted);
+            std::vector<std::pair<std::string, std::string>> fields = {
+                {"unit", bench_detail::jsonValue(metric.unit)},
+                {"lower_is_better", bench_detail::jsonValue(metric.lower_is_better)},
+                {"count", bench_detail::jsonValue(s.count)},
+                {"mean", bench_detail::jsonValue(s.mean)},
+                {"stddev", bench_detail::jsonValue(s.stddev)},
+                {"min", bench_detail::jsonValue(s.min)},
+                {"median", bench_detail::jsonValue(s.median)},
+                {"p90", bench_detail::jsonValue(s.p90)},
+                {"p99", bench_detail::jsonValue(s.p99)},
+                {"max", bench_detail::jsonValue(s.max)},
+            };
+            // Quantile sketch: evenly spaced order statistics of the sorted samples
+            size_t keep = std::min(sorted.size(), kMaxStoredSamples);
+            std::string samples = "[";
+            for (size_t i = 0; i < keep; ++i) {
+                size_t at = keep == sorted.size() ? i : (i * (sorted.size() - 1)) / (keep - 1);
+                samples += (i ? ", " : "") + bench_detail::jsonNumber(sorted[at]);
+            }
+            fields.emplace_back("samples", samples + "]");
+            out << (first ? "\n    " : ",\n    ") << bench_detail::jsonEscape(name) << ": ";
+            writeFields(out, fields);
+            first = false;
+        }
+        out << "\n  }\n}\n";
+    }
+
+    void writeToFile(const std::string& path) const {
+        std::ofstream out(path, std::ios::trunc);
+        if (!out) {
+            throw std::runtime_error("Failed to open benchmark report for writing: " + path);
+        }
+        write(out);
+        if (!out) {
+            throw std::runtime_error("Failed to write benchmark report: " + path);
+        }
+    }
+};
+
+// Minimal JSON document model, enough for bench_compare to read reports back
+struct JsonValue {
+    enum class Type { Null, Bool, Number, String, Array, Object };
+
+    Type type = Type::Null;
+    bool boolean = false;
+    double number = 0.0;
+    std::string string;
+    std::vector<JsonValue> array;
+    std::vector<std::pair<std::string, JsonValue>> object;
+
+    const JsonValue* find(const std::string& key) const {
+        for (const auto& member : object) {
+            if (member.first == key) {
+                return &member.second;
+            }
+        }
+        return nullptr;
+    }
+
+    double numberOr(const std::string& key, double fallback) const {
+        const JsonValue* value = find(key);
+        return value && value->type == Type::Number ? value->number : fallback;
+    }
+
+    std::string stringOr(const std::string& key, const std::string& fallback) const {
+        const JsonValue* value = find(key);
+        return value && value->type == Type::String ? value->string : fallback;
+    }
+};
+
+namespace bench_detail {
+
+class JsonParser {
+private:
+    const std::string& text;
+    size_t pos = 0;
+
+    [[noreturn]] void fail(const std::string& what) const {
+        throw std::runtime_error("Invalid JSON at offset " + std::to_string(pos) + ": " + what);
+    }
+
+    void skipSpace() {
+        while (pos < text.size() && std::isspace(static_cast<unsigned char>(text[pos]))) {
+            ++pos;
+        }
+    }
+
+    void expect(char c) {
+        skipSpace();
+        if (pos >= text.size() || text[pos] != c) {
+            fail(std::string("expected '") + c + "'");
+        }
+        ++pos;
+    }
+
+    bool consume(const char* literal) {
+        size_t length = std::char_traits<char>::length(literal);
+        if (text.compare(pos, length, literal) == 0) {
+            pos += length;
+            return true;
+        }
+        return false;
+    }
+
+    std::string parseString() {
+        expect('"');
+        std::string out;
+        while (pos < text.size() && text[pos] != '"') {
+            char c = text[pos++];
+            if (c != '\\') {
+                out += c;
+                continue;
+            }
+            if (pos >= text.size()) {
+                fail("unterminated escape");
+            }
+            char e = text[pos++];
+            switch (e) {
+                case 'n': out += '\n'; break;
+                case 't': out += '\t'; break;
+                case 'r': out += '\r'; break;
+                case 'b': out += '\b'; break;
+                case 'f': out += '\f'; break;
+                case 'u': {
+                    if (pos + 4 > text.size()) {
+                        fail("short unicode escape");
+                    }
+                    unsigned code = std::stoul(text.substr(pos, 4), nullptr, 16);
+                    pos += 4;
+                    // Reports only escape control characters; anything wider is kept as '?'
+                    out += code < 0x80 ? static_cast<char>(code) : '?';
+                    break;
+                }
+                default: out += e;
+            }
+        }
+        expect('"');
+        return out;
+    }
+
+public:
+    explicit JsonParser(const std::string& text) : text(text) {}
+
+    JsonValue parse() {
+        JsonValue value = parseValue();
+        skipSpace();
+        if (pos != text.size()) {
+            fail("trailing characters");
+        }
+        return value;
+    }
+
+    JsonValue parseValue() {
+        skipSpace();
+        if (pos >= text.size()) {
+            fail("unexpected end");
+        }
+        JsonValue value;
+        char c = text[pos];
+        if (c == '{') {
+            value.type = JsonValue::Type::Object;
+            ++pos;
+            skipSpace();
+            if (pos < text.size() && text[pos] == '}') {
+                ++pos;
+                return value;
+            }
+            while (true) {
+                std::string key = parseString();
+                expect(':');
+                value.object.emplace_back(std::move(key), parseValue());
+                skipSpace();
+                if (pos < text.size() && text[pos] == ',') {
+                    ++pos;
+                    skipSpace();
+                    continue;
+                }
+                expect('}');
+                return value;
+            }
+        }
+        if (c == '[') {
+            value.type = JsonValue::Type::Array;
+            ++pos;
+            skipSpace();
+            if (pos < text.size() && text[pos] == ']') {
+                ++pos;
+                return value;
+            }
+            while (true) {
+                value.array.push_back(parseValue());
+                skipSpace();
+                if (pos < text.size() && text[pos] == ',') {
+                    ++pos;
+                    continue;
+                }
+                expect(']');
+                return value;
+            }
+        }
+        if (c == '"') {
+            value.type = JsonValue::Type::String;
+            value.string = parseString();
+            return value;
+        }
+        if (consume("true")) {
+            value.type = JsonValue::Type::Bool;
+            value.boolean = true;
+            return value;
+        }
+        if (consume("false")) {
+            value.type = JsonValue::Type::Bool;
+            return value;
+        }
+        if (consume("null")) {
+            return value;
+        }
+        const char* begin = text.c_str() + pos;
+        char* end = nullptr;
+        value.number = std::strtod(begin, &end);
+        if (end == begin) {
+            fail("unexpected character");
+        }
+        value.type = JsonValue::Type::Number;
+        pos += end - begin;
+        return value;
+    }
+};
+
+}  // namespace bench_detail
+
+inline JsonValue parseJson(const std::string& text) {
+    return bench_detail::JsonParser(text).parse();
+}
+
+inline JsonValue readJsonFile(const std::string& path) {
+    std::ifstream in(path);
+    if (!in) {
+        throw std::runtime_error("Failed to open " + path);
+    }
+    std::stringstream buffer;
+    buffer << in.rdbuf();
+    return parseJson(buffer.str());
+}
+
+#endif // BENCH_REPORT_HPP
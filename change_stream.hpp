@@ -0,0 +1,138 @@
+#ifndef CHANGE_STREAM_HPP
+#define CHANGE_STREAM_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+enum class ChangeType : uint8_t {
+    Insert = 0,
+    Update = 1,
+    Delete = 2,
+};
+
+// One mutation of a keyspace. `sequence` numbers are contiguous per keyspace,
+// starting at 1; `index` is the row position the change applied to.
+struct ChangeEvent {
+    uint64_t sequence = 0;
+    ChangeType type = ChangeType::Insert;
+    uint64_t index = 0;
+    std::vector<double> values;  // empty for deletes
+};
+
+// Resumable position in a keyspace's change stream. Consumers may persist
+// `next_sequence` and resume from it later.
+struct ChangeCursor {
+    uint64_t next_sequence = 1;
+};
+
+// Bounded ring of the most recent change events of one keyspace.
+//
+// There is a single producer (the keyspace writer, which holds the keyspace
+// lock) and any number of consumers. Each slot is a sequence lock over atomic
+// fields: the producer bumps the slot version to odd, writes, and bumps it to
+// even again; a consumer retries if the version moved while it was copying.
+// Consumers therefore never block the producer or each other.
+class ChangeStream {
+public:
+    enum class ReadStatus {
+        Ok,       // every requested event that exists was returned
+        Overrun,  // the cursor points before the oldest event still buffered
+    };
+
+private:
+    struct Slot {
+        std::atomic<uint64_t> version{0};
+        std::atomic<uint64_t> sequence{0};
+        std::atomic<uint8_t> type{0};
+        std::atomic<uint64_t> index{0};
+        std::atomic<uint32_t> value_count{0};
+    };
+
+    size_t capacity;
+    size_t dimension;
+    std::unique_ptr<Slot[]> slots;
+    std::unique_ptr<std::atomic<double>[]> values;  // capacity * dimension
+    std::atomic<uint64_t> head;                     // last published sequence
+    uint64_t first_sequence;                        // first sequence this ring ever held
+
+public:
+    // `start_sequence` is the keyspace's current sequence; the ring buffers what follows
+    ChangeStream(size_t capacity, size_t dimension, uint64_t start_sequence)
+        : capacity(capacity), dimension(dimension), slots(new Slot[capacity]),
+          values(new std::atomic<double>[capacity * dimension]), head(start_sequence),
+          first_sequence(start_sequence + 1) {
+        for (size_t i = 0; i < capacity * dimension; ++i) {
+            values[i].store(0.0, std::memory_order_relaxed);
+        }
+    }
+
+    uint64_t lastSequence() const { return head.load(std::memory_order_acquire); }
+
+    // Oldest sequence still readable from the ring
+    uint64_t oldestSequence() const {
+        uint64_t last = lastSequence();
+        uint64_t oldest = last >= capacity ? last - capacity + 1 : 1;
+        return std::max(oldest, first_sequence);
+    }
+
+    // Producer only. `sequence` must be lastSequence() + 1.
+    void publish(uint64_t sequence, ChangeType type, uint64_t index, const double* row) {
+        Slot& slot = slots[sequence % capacity];
+        uint64_t version = slot.version.load(std::memory_order_relaxed);
+        slot.version.store(version + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+
+        slot.sequence.store(sequence, std::memory_order_relaxed);
+        slot.type.store(static_cast<uint8_t>(type), std::memory_order_relaxed);
+        slot.index.store(index, std::memory_order_relaxed);
+        uint32_t count = row ? static_cast<uint32_t>(dimension) : 0;
+        slot.value_count.store(count, std::memory_order_relaxed);
+        std::atomic<double>* target = &values[(sequence % capacity) * dimension];
+        for (uint32_t i = 0; i < count; ++i) {
+            target[i].store(row[i], std::memory_order_relaxed);
+        }
+
+        slot.version.store(version + 2, std::memory_order_release);
+        head.store(sequence, std::memory_order_release);
+    }
+
+    // Append up to `max_events` events starting at `from` to `out`
+    ReadStatus read(uint64_t from, size_t max_events, std::vector<ChangeEvent>& out) const {
+        uint64_t last = lastSequence();
+        for (uint64_t sequence = from; sequence <= last && max_events > 0; ++sequence, --max_events) {
+            if (sequence < oldestSequence()) {
+                return ReadStatus::Overrun;
+            }
+            const Slot& slot = slots[sequence % capacity];
+            const std::atomic<double>* source = &values[(sequence % capacity) * dimension];
+            ChangeEvent event;
+            while (true) {
+                uint64_t before = slot.version.load(std::memory_order_acquire);
+                if (before & 1) {
+                    continue;  // producer is writing this slot
+                }
+                if (slot.sequence.load(std::memory_order_relaxed) != sequence) {
+                    return ReadStatus::Overrun;  // already overwritten by a newer event
+                }
+                event.sequence = sequence;
+                event.type = static_cast<ChangeType>(slot.type.load(std::memory_order_relaxed));
+                event.index = slot.index.load(std::memory_order_relaxed);
+                event.values.resize(std::min<size_t>(slot.value_count.load(std::memory_order_relaxed), dimension));
+                for (size_t i = 0; i < event.values.size(); ++i) {
+                    event.values[i] = source[i].load(std::memory_order_relaxed);
+                }
+                std::atomic_thread_fence(std::memory_order_acquire);
+                if (slot.version.load(std::memory_order_relaxed) == before) {
+                    break;
+                }
+            }
+            out.push_back(std::move(event));
+        }
+        return ReadStatus::Ok;
+    }
+};
+
+#endif // CHANGE_STREAM_HPP
@@ -0,0 +1,78 @@
+#ifndef CPU_INFO_HPP
+#define CPU_INFO_HPP
+
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// Identification of the CPU a process runs on, for benchmark reports and for
+// deciding whether cached kernel calibrations still apply.
+
+inline std::string readCpuModel() {
+    std::ifstream cpuinfo("/proc/cpuinfo");
+    std::string line;
+    while (std::getline(cpuinfo, line)) {
+        if (line.rfind("model name", 0) == 0 || line.rfind("Model", 0) == 0) {
+            size_t colon = line.find(':');
+            if (colon != std::string::npos) {
+                return line.substr(line.find_first_not_of(" \t", colon + 1));
+            }
+        }
+    }
+    return "unknown";
+}
+
+// SIMD features the CPU reports, limited to the ones that matter for the kernels
+inline std::vector<std::string> detectCpuFlags() {
+    std::vector<std::string> flags;
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_cpu_init();
+#define CPU_INFO_FLAG(name) if (__builtin_cpu_supports(name)) flags.push_back(name)
+    CPU_INFO_FLAG("sse2");
+    CPU_INFO_FLAG("sse4.2");
+    CPU_INFO_FLAG("popcnt");
+    CPU_INFO_FLAG("avx");
+    CPU_INFO_FLAG("avx2");
+    CPU_INFO_FLAG("fma");
+    CPU_INFO_FLAG("avx512f");
+    CPU_INFO_FLAG("avx512bw");
+    CPU_INFO_FLAG("avx512vl");
+#undef CPU_INFO_FLAG
+#else
+    std::ifstream cpuinfo("/proc/cpuinfo");
+    std::string line;
+    while (std::getline(cpuinfo, line)) {
+        if (line.rfind("Features", 0) == 0) {
+            std::istringstream words(line.substr(line.find(':') + 1));
+            std::string word;
+            while (words >> word) {
+                flags.push_back(word);
+            }
+            break;
+        }
+    }
+#endif
+    return flags;
+}
+
+// SIMD level the binary itself was compiled for
+inline std::string compiledSimd() {
+#if defined(__AVX512F__)
+    return "avx512f";
+#elif defined(__AVX2__)
+    return "avx2";
+#elif defined(__AVX__)
+    return "avx";
+#elif defined(__SSE4_2__)
+    return "sse4.2";
+#elif defined(__SSE2__)
+    return "sse2";
+#elif defined(__ARM_NEON)
+    return "neon";
+#else
+    return "none";
+#endif
+}
+
+#endif // CPU_INFO_HPP
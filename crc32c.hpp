@@ -0,0 +1,121 @@
+#ifndef CRC32C_HPP
+#define CRC32C_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#include <nmmintrin.h>
+#define CRC32C_HAVE_X86_HW 1
+#elif defined(__aarch64__) && defined(__ARM_FEATURE_CRC32)
+#include <arm_acle.h>
+#define CRC32C_HAVE_ARM_HW 1
+#endif
+
+// CRC32C (Castagnoli) checksums used to verify WAL records and snapshot segments.
+// Uses the SSE4.2 / ARMv8 CRC instructions when the CPU has them and a
+// slicing-by-8 table implementation otherwise.
+
+namespace crc32c_detail {
+
+constexpr uint32_t kPolynomial = 0x82F63B78;  // reflected Castagnoli polynomial
+
+struct Tables {
+    uint32_t table[8][256];
+
+    Tables() {
+        for (uint32_t i = 0; i < 256; ++i) {
+            uint32_t crc = i;
+            for (int bit = 0; bit < 8; ++bit) {
+                crc = (crc >> 1) ^ ((crc & 1) ? kPolynomial : 0);
+            }
+            table[0][i] = crc;
+        }
+        for (uint32_t i = 0; i < 256; ++i) {
+            for (int slice = 1; slice < 8; ++slice) {
+                uint32_t prev = table[slice - 1][i];
+                table[slice][i] = (prev >> 8) ^ table[0][prev & 0xFF];
+            }
+        }
+    }
+};
+
+inline const Tables& tables() {
+    static const Tables instance;
+    return instance;
+}
+
+inline uint32_t software(uint32_t crc, const uint8_t* p, size_t n) {
+    const auto& t = tables().table;
+    while (n >= 8) {
+        uint64_t word;
+        std::memcpy(&word, p, 8);
+        uint32_t lo = static_cast<uint32_t>(word) ^ crc;
+        uint32_t hi = static_cast<uint32_t>(word >> 32);
+        crc = t[7][lo & 0xFF] ^ t[6][(lo >> 8) & 0xFF] ^ t[5][(lo >> 16) & 0xFF] ^ t[4][lo >> 24] ^
+              t[3][hi & 0xFF] ^ t[2][(hi >> 8) & 0xFF] ^ t[1][(hi >> 16) & 0xFF] ^ t[0][hi >> 24];
+        p += 8;
+        n -= 8;
+    }
+    while (n-- > 0) {
+        crc = (crc >> 8) ^ t[0][(crc ^ *p++) & 0xFF];
+    }
+    return crc;
+}
+
+#if defined(CRC32C_HAVE_X86_HW)
+__attribute__((target("sse4.2")))
+inline uint32_t hardware(uint32_t crc, const uint8_t* p, size_t n) {
+    uint64_t crc64 = crc;
+    while (n >= 8) {
+        uint64_t word;
+        std::memcpy(&word, p, 8);
+        crc64 = _mm_crc32_u64(crc64, word);
+        p += 8;
+        n -= 8;
+    }
+    crc = static_cast<uint32_t>(crc64);
+    while (n-- > 0) {
+        crc = _mm_crc32_u8(crc, *p++);
+    }
+    return crc;
+}
+
+inline bool hardwareAvailable() {
+    static const bool available = __builtin_cpu_supports("sse4.2");
+    return available;
+}
+#elif defined(CRC32C_HAVE_ARM_HW)
+inline uint32_t hardware(uint32_t crc, const uint8_t* p, size_t n) {
+    while (n >= 8) {
+        uint64_t word;
+        std::memcpy(&word, p, 8);
+        crc = __crc32cd(crc, word);
+        p += 8;
+        n -= 8;
+    }
+    while (n-- > 0) {
+        crc = __crc32cb(crc, *p++);
+    }
+    return crc;
+}
+
+inline bool hardwareAvailable() { return true; }
+#endif
+
+} // namespace crc32c_detail
+
+// Checksum `length` bytes. Pass a previous result as `seed` to checksum data in pieces.
+inline uint32_t crc32c(const void* data, size_t length, uint32_t seed = 0) {
+    const uint8_t* p = static_cast<const uint8_t*>(data);
+    uint32_t crc = ~seed;
+#if defined(CRC32C_HAVE_X86_HW) || defined(CRC32C_HAVE_ARM_HW)
+    if (crc32c_detail::hardwareAvailable()) {
+        return ~crc32c_detail::hardware(crc, p, length);
+    }
+#endif
+    return ~crc32c_detail::software(crc, p, length);
+}
+
+#endif // CRC32C_HPP
@@ -0,0 +1,223 @@
+#ifndef DATASET_GENERATOR_HPP
+#define DATASET_GENERATOR_HPP
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <stdexcept>
+#include <vector>
+#include "parallel_for.hpp"
+
+// Seeded synthetic datasets for benchmarks and tests.
+//
+// Rows are generated in fixed-size blocks, each with its own random stream
+// derived from the seed and the block number, so the output depends only on
+// the spec and never on the thread count. Blocks are generated in parallel and
+// each block fills whole buffers of uniforms first and then transforms them in
+// straight loops the compiler can vectorize.
+
+enum class DatasetDistribution {
+    Uniform,     // every element uniform in [-1, 1)
+    Gaussian,    // every element standard normal
+    Clustered,   // Gaussian mixture around random centers, optionally on low-dimensional subspaces
+    Normalized,  // uniform on the unit sphere
+};
+
+struct DatasetSpec {
+    size_t count = 0;
+    size_t dimension = 0;
+    DatasetDistribution distribution = DatasetDistribution::Uniform;
+    uint64_t seed = 42;
+    // Clustered only
+    size_t clusters = 16;
+    size_t intrinsic_dimension = 0;  // dimension of each cluster's subspace, 0 = full dimension
+    double cluster_spread = 0.1;     // standard deviation within a cluster
+    double noise = 0.01;             // isotropic noise added off the subspace
+};
+
+namespace dataset_detail {
+
+constexpr size_t kBlockRows = 4096;
+
+inline uint64_t splitmix64(uint64_t& state) {
+    uint64_t z = (state += 0x9E3779B97F4A7C15ull);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    return z ^ (z >> 31);
+}
+
+// xoshiro256+ : fast, and its top 53 bits are good enough for doubles
+class Random {
+private:
+    uint64_t s[4];
+
+    static uint64_t rotl(uint64_t x, int k) { return (x << k) | (x >> (64 - k)); }
+
+public:
+    Random(uint64_t seed, uint64_t stream) {
+        uint64_t state = seed ^ (stream * 0xD1B54A32D192ED03ull);
+        for (auto& word : s) {
+            word = splitmix64(state);
+        }
+    }
+
+    uint64_t next() {
+        uint64_t result = s[0] + s[3];
+        uint64_t t = s[1] << 17;
+        s[2] ^= s[0];
+        s[3] ^= s[1];
+        s[1] ^= s[2];
+        s[0] ^= s[3];
+        s[2] ^= t;
+        s[3] = rotl(s[3], 45);
+        return result;
+    }
+
+    // Uniform in [0, 1)
+    double uniform() { return static_cast<double>(next() >> 11) * 0x1.0p-53; }
+
+    void fillUniform(double* out, size_t n) {
+        for (size_t i = 0; i < n; ++i) {
+            out[i] = uniform();
+        }
+    }
+
+    // Standard normals by Box-Muller over pairs of uniforms
+    void fillGaussian(double* out, size_t n) {
+        size_t even = n & ~size_t(1);
+        fillUniform(out, even);
+        for (size_t i = 0; i < even; i += 2) {
+            double radius = std::sqrt(-2.0 * std::log(1.0 - out[i]));
+            double angle = 6.283185307179586 * out[i + 1];
+            out[i] = radius * std::cos(angle);
+            out[i + 1] = radius * std::sin(angle);
+        }
+        if (even < n) {
+            double u1 = uniform(), u2 = uniform();
+            out[even] = std::sqrt(-2.0 * std::log(1.0 - u1)) * std::cos(6.283185307179586 * u2);
+        }
+    }
+};
+
+// Cluster centers and subspace bases, derived from the seed alone
+struct MixtureModel {
+    size_t intrinsic = 0;
+    std::vector<double> centers;  // clusters * dimension
+    std::vector<double> bases;    // clusters * intrinsic * dimension, empty for full dimension
+
+    MixtureModel(const DatasetSpec& spec) {
+        Random random(spec.seed, ~uint64_t(0));
+        centers.resize(spec.clusters * spec.dimension);
+        random.fillUniform(centers.data(), centers.size());
+        for (double& c : centers) {
+            c = 2.0 * c - 1.0;
+        }
+        if (spec.intrinsic_dimension > 0 && spec.intrinsic_dimension < spec.dimension) {
+            intrinsic = spec.intrinsic_dimension;
+            bases.resize(spec.clusters * intrinsic * spec.dimension);
+            random.fillGaussian(bases.data(), bases.size());
+            // Unit-length basis vectors keep cluster_spread meaningful in any dimension
+            for (size_t b = 0; b < spec.clusters * intrinsic; ++b) {
+                double* v = &bases[b * spec.dimension];
+                double norm = 0.0;
+                for (size_t i = 0; i < spec.dimension; ++i) {
+                    norm += v[i] * v[i];
+                }
+                double scale = norm > 0 ? 1.0 / std::sqrt(norm) : 0.0;
+                for (size_t i = 0; i < spec.dimension; ++i) {
+                    v[i] *= scale;
+                }
+            }
+        }
+    }
+};
+
+inline void generateBlock(const DatasetSpec& spec, const MixtureModel* model, size_t block, double* out) {
+    size_t first = block * kBlockRows;
+    size_t rows = std::min(kBlockRows, spec.count - first);
+    size_t dim = spec.dimension;
+    size_t n = rows * dim;
+    Random random(spec.seed, block);
+
+    switch (spec.distribution) {
+        case DatasetDistribution::Uniform:
+            random.fillUniform(out, n);
+            for (size_t i = 0; i < n; ++i) {
+                out[i] = 2.0 * out[i] - 1.0;
+            }
+            break;
+        case DatasetDistribution::Gaussian:
+            random.fillGaussian(out, n);
+            break;
+        case DatasetDistribution::Normalized:
+            random.fillGaussian(out, n);
+            for (size_t r = 0; r < rows; ++r) {
+                double* row = out + r * dim;
+                double norm = 0.0;
+                for (size_t i = 0; i < dim; ++i) {
+                    norm += row[i] * row[i];
+                }
+                double scale = norm > 0 ? 1.0 / std::sqrt(norm) : 0.0;
+                for (size_t i = 0; i < dim; ++i) {
+                    row[i] *= scale;
+                }
+            }
+            break;
+        case DatasetDistribution::Clustered: {
+            std::vector<double> latent(model->intrinsic);
+            for (size_t r = 0; r < rows; ++r) {
+                double* row = out + r * dim;
+                size_t cluster = static_cast<size_t>(random.next() % spec.clusters);
+                const double* center = &model->centers[cluster * dim];
+                if (model->intrinsic == 0) {
+                    random.fillGaussian(row, dim);
+                    for (size_t i = 0; i < dim; ++i) {
+                        row[i] = center[i] + spec.cluster_spread * row[i];
+                    }
+                    continue;
+                }
+                random.fillGaussian(row, dim);
+                for (size_t i = 0; i < dim; ++i) {
+                    row[i] = center[i] + spec.noise * row[i];
+                }
+                random.fillGaussian(latent.data(), latent.size());
+                const double* basis = &model->bases[cluster * model->intrinsic * dim];
+                for (size_t b = 0; b < model->intrinsic; ++b) {
+                    double weight = spec.cluster_spread * latent[b];
+                    const double* v = basis + b * dim;
+                    for (size_t i = 0; i < dim; ++i) {
+                        row[i] += weight * v[i];
+                    }
+                }
+            }
+            break;
+        }
+    }
+}
+
+}  // namespace dataset_detail
+
+// Generate `spec.count` rows of `spec.dimension` doubles, row after row
+inline std::vector<double> generateDataset(const DatasetSpec& spec, size_t max_threads = 0) {
+    if (spec.dimension == 0) {
+        throw std::invalid_argument("Dataset dimension must be positive");
+    }
+    if (spec.distribution == DatasetDistribution::Clustered && spec.clusters == 0) {
+        throw std::invalid_argument("Clustered dataset needs at least one cluster");
+    }
+    std::vector<double> values(spec.count * spec.dimension);
+    std::unique_ptr<dataset_detail::MixtureModel> model;
+    if (spec.distribution == DatasetDistribution::Clustered) {
+        model = std::make_unique<dataset_detail::MixtureModel>(spec);
+    }
+    size_t blocks = (spec.count + dataset_detail::kBlockRows - 1) / dataset_detail::kBlockRows;
+    parallelFor(blocks, [&](size_t block) {
+        dataset_detail::generateBlock(spec, model.get(), block,
+                                      values.data() + block * dataset_detail::kBlockRows * spec.dimension);
+    }, max_threads);
+    return values;
+}
+
+#endif // DATASET_GENERATOR_HPP
@@ -0,0 +1,73 @@
+#ifndef DIMENSION_WEIGHTS_HPP
+#define DIMENSION_WEIGHTS_HPP
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+// Per-query weighting of dimensions for similarity searches.
+//
+// Weights scale each dimension's term inside the distance (the squared
+// difference, absolute difference or product) as the kernel accumulates it,
+// so the stored rows are never rescaled or copied. A mask is the special case
+// of 0/1 weights: masked kernels only visit the kept dimensions and skip the
+// multiplications. Any weight vector made of zeros and ones is treated as a
+// mask. Build the weights once per personalization and reuse them; searches
+// do not copy them.
+
+class DimensionWeights {
+private:
+    std::vector<double> values;
+    std::vector<uint32_t> active;  // dimensions with weight 1, set for masks
+    bool masked = false;
+
+    void classify() {
+        masked = true;
+        for (size_t i = 0; i < values.size(); ++i) {
+            if (values[i] != 0.0 && values[i] != 1.0) {
+                masked = false;
+            }
+            if (values[i] != 0.0) {
+                active.push_back(static_cast<uint32_t>(i));
+            }
+        }
+        if (active.empty()) {
+            throw std::invalid_argument("Dimension weights must keep at least one dimension");
+        }
+        if (!masked) {
+            active.clear();
+        }
+    }
+
+public:
+    // Scale dimension i by weights[i]; weights must be finite and non-negative
+    explicit DimensionWeights(std::vector<double> weights) : values(std::move(weights)) {
+        for (double w : values) {
+            if (!std::isfinite(w) || w < 0.0) {
+                throw std::invalid_argument("Dimension weights must be finite and non-negative");
+            }
+        }
+        classify();
+    }
+
+    // Keep only the dimensions where `keep` is true
+    static DimensionWeights mask(const std::vector<bool>& keep) {
+        std::vector<double> weights(keep.size());
+        for (size_t i = 0; i < keep.size(); ++i) {
+            weights[i] = keep[i] ? 1.0 : 0.0;
+        }
+        return DimensionWeights(std::move(weights));
+    }
+
+    size_t dimension() const { return values.size(); }
+    bool isMask() const { return masked; }
+    const double* data() const { return values.data(); }
+
+    // Kept dimensions, in order; only meaningful for masks
+    const std::vector<uint32_t>& activeDimensions() const { return active; }
+};
+
+#endif // DIMENSION_WEIGHTS_HPP
@@ -0,0 +1,500 @@
+#ifndef DISTANCE_KERNELS_HPP
+#define DISTANCE_KERNELS_HPP
+
+#include <array>
+#include <atomic>
+#include <cmath>
+#include <cstddef>
+#include <limits>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+#include "dimension_weights.hpp"
+#include "keyspace_spec.hpp"
+#include "keyspace_storage.hpp"
+#include "prefetch.hpp"
+
+// Distance kernels. Each kernel defines a distance where smaller is closer and
+// the similarity reported by threshold searches. Every distance is also
+// expressed as per-element terms folded into kSums running sums and a final
+// step, which lets the scans below be instantiated with several independent
+// accumulators (lanes) and several rows per pass (tiles); kernel_calibration.hpp
+// measures which combination is fastest on the running CPU. accumulateWeighted
+// folds a per-dimension weight into the same terms, so weighted searches run
+// through the same variants and are calibrated alongside.
+
+struct EuclideanKernel {
+    static constexpr const char* kName = "euclidean";
+
+    static double distance(const double* a, const double* b, size_t dim) {
+        double sum = 0.0;
+        for (size_t i = 0; i < dim; ++i) {
+            double diff = a[i] - b[i];
+            sum += diff * diff;
+        }
+        return std::sqrt(sum);
+    }
+    static double similarity(double distance) { return 1.0 / (1.0 + distance); }
+
+    static constexpr size_t kSums = 1;
+    static void accumulate(double a, double b, double* sums) {
+        double diff = a - b;
+        sums[0] += diff * diff;
+    }
+    static void accumulateWeighted(double a, double b, double w, double* sums) {
+        double diff = a - b;
+        sums[0] += w * diff * diff;
+    }
+    static double finish(const double* sums) { return std::sqrt(sums[0]); }
+};
+
+struct ManhattanKernel {
+    static constexpr const char* kName = "manhattan";
+
+    static double distance(const double* a, const double* b, size_t dim) {
+        double sum = 0.0;
+        for (size_t i = 0; i < dim; ++i) {
+            sum += std::abs(a[i] - b[i]);
+        }
+        return sum;
+    }
+    static double similarity(double distance) { return 1.0 / (1.0 + distance); }
+
+    static constexpr size_t kSums = 1;
+    static void accumulate(double a, double b, double* sums) { sums[0] += std::abs(a - b); }
+    static void accumulateWeighted(double a, double b, double w, double* sums) { sums[0] += w * std::abs(a - b); }
+    static double finish(const double* sums) { return sums[0]; }
+};
+
+// Cosine distance (1 - cosine similarity) for vectors of arbitrary length
+struct CosineKernel {
+    static constexpr const char* kName = "cosine";
+
+    static double distance(const double* a, const double* b, size_t dim) {
+        double dot = 0.0, norm_a = 0.0, norm_b = 0.0;
+        for (size_t i = 0; i < dim; ++i) {
+            dot += a[i] * b[i];
+            norm_a += a[i] * a[i];
+            norm_b += b[i] * b[i];
+        }
+        double magnitude = std::sqrt(norm_a * norm_b);
+        return magnitude == 0 ? 1.0 : 1.0 - dot / magnitude;
+    }
+    static double similarity(double distance) { return 1.0 - distance; }
+
+    static constexpr size_t kSums = 3;
+    static void accumulate(double a, double b, double* sums) {
+        sums[0] += a * b;
+        sums[1] += a * a;
+        sums[2] += b * b;
+    }
+    static void accumulateWeighted(double a, double b, double w, double* sums) {
+        sums[0] += w * a * b;
+        sums[1] += w * a * a;
+        sums[2] += w * b * b;
+    }
+    static double finish(const double* sums) {
+        double magnitude = std::sqrt(sums[1] * sums[2]);
+        return magnitude == 0 ? 1.0 : 1.0 - sums[0] / magnitude;
+    }
+};
+
+// Cosine distance when both sides are already unit length: a plain dot
+// product. Weighting breaks unit length, so weighted searches use CosineKernel.
+struct UnitCosineKernel {
+    static constexpr const char* kName = "cosine-unit";
+
+    static double distance(const double* a, const double* b, size_t dim) {
+        double dot = 0.0;
+        for (size_t i = 0; i < dim; ++i) {
+            dot += a[i] * b[i];
+        }
+        return 1.0 - dot;
+    }
+    static double similarity(double distance) { return 1.0 - distance; }
+
+    static constexpr size_t kSums = 1;
+    static void accumulate(double a, double b, double* sums) { sums[0] += a * b; }
+    static double finish(const double* sums) { return 1.0 - sums[0]; }
+};
+
+// Negated dot product, so the row with the largest inner product is the
+// nearest; threshold searches report the dot product itself
+struct InnerProductKernel {
+    static constexpr const char* kName = "inner_product";
+
+    static double distance(const double* a, const double* b, size_t dim) {
+        double dot = 0.0;
+        for (size_t i = 0; i < dim; ++i) {
+            dot += a[i] * b[i];
+        }
+        return -dot;
+    }
+    static double similarity(double distance) { return -distance; }
+
+    static constexpr size_t kSums = 1;
+    static void accumulate(double a, double b, double* sums) { sums[0] += a * b; }
+    static void accumulateWeighted(double a, double b, double w, double* sums) { sums[0] += w * a * b; }
+    static double finish(const double* sums) { return -sums[0]; }
+};
+
+// Scale a vector to unit length in place; zero vectors are left unchanged
+inline void normalizeInPlace(double* values, size_t dim) {
+    double norm = 0.0;
+    for (size_t i = 0; i < dim; ++i) {
+        norm += values[i] * values[i];
+    }
+    if (norm > 0) {
+        double scale = 1.0 / std::sqrt(norm);
+        for (size_t i = 0; i < dim; ++i) {
+            values[i] *= scale;
+        }
+    }
+}
+
+// Prefetch the row `ahead` rows past row `r` of `page` (which has `rows`
+// rows) when that row is in the next page. Rows inside a page are left to
+// the hardware prefetcher, which follows them fine.
+inline void prefetchAhead(const KeyspaceData& data, size_t page, size_t r, size_t rows, size_t ahead, size_t dim) {
+    size_t target = r + ahead;
+    if (ahead == 0 || target < rows) {
+        return;
+    }
+    if (page + 1 < data.pageCount() && target - rows < data.rowsInPage(page + 1)) {
+        prefetchRow(data.pageRows(page + 1) + (target - rows) * dim, dim);
+    }
+}
+
+template <typename Kernel>
+size_t scanNearest(const KeyspaceData& data, const double* query, size_t dim) {
+    size_t nearest_idx = 0;
+    double min_distance = std::numeric_limits<double>::infinity();
+    size_t ahead = scanPrefetchRows();
+    for (size_t page = 0; page < data.pageCount(); ++page) {
+        const double* row = data.pageRows(page);
+        size_t first = data.firstRow(page);
+        size_t rows = data.rowsInPage(page);
+        for (size_t r = 0; r < rows; ++r, row += dim) {
+            prefetchAhead(data, page, r, rows, ahead, dim);
+            double dist = Kernel::distance(query, row, dim);
+            if (dist < min_distance) {
+                min_distance = dist;
+                nearest_idx = first + r;
+            }
+        }
+    }
+    return nearest_idx;
+}
+
+template <typename Kernel>
+void scanThreshold(const KeyspaceData& data, const double* query, size_t dim, double threshold,
+                   std::vector<std::pair<size_t, double>>& results) {
+    size_t ahead = scanPrefetchRows();
+    for (size_t page = 0; page < data.pageCount(); ++page) {
+        const double* row = data.pageRows(page);
+        size_t first = data.firstRow(page);
+        size_t rows = data.rowsInPage(page);
+        for (size_t r = 0; r < rows; ++r, row += dim) {
+            prefetchAhead(data, page, r, rows, ahead, dim);
+            double similarity = Kernel::similarity(Kernel::distance(query, row, dim));
+            if (similarity >= threshold) {
+                results.emplace_back(first + r, similarity);
+            }
+        }
+    }
+}
+
+// Which terms a scan folds into a distance: every dimension, every dimension
+// scaled by its weight, or only the kept dimensions of a mask
+enum class ScanTerms { Plain, Weighted, Masked };
+
+// Distances from `query` to the `Tile` rows starting at `rows`, each summed
+// in `Lanes` interleaved accumulators. Loading a query element once per tile
+// instead of once per row, and breaking the add dependency chain across
+// lanes, are the two knobs calibration tunes. Weighted and masked scans take
+// their weights from `weights`; a masked scan steps through the kept
+// dimensions, so its lanes interleave those instead.
+template <typename Kernel, size_t Lanes, size_t Tile, ScanTerms Terms = ScanTerms::Plain>
+inline void tileDistances(const double* query, const double* rows, size_t dim, double* out,
+                          const DimensionWeights* weights = nullptr) {
+    double sums[Tile][Lanes][Kernel::kSums] = {};
+    size_t terms = dim;
+    const uint32_t* kept = nullptr;
+    const double* w = nullptr;
+    if constexpr (Terms == ScanTerms::Masked) {
+        terms = weights->activeDimensions().size();
+        kept = weights->activeDimensions().data();
+    } else if constexpr (Terms == ScanTerms::Weighted) {
+        w = weights->data();
+    }
+    auto add = [&](size_t term, size_t lane) {
+        size_t i = Terms == ScanTerms::Masked ? kept[term] : term;
+        double q = query[i];
+        for (size_t t = 0; t < Tile; ++t) {
+            if constexpr (Terms == ScanTerms::Weighted) {
+                Kernel::accumulateWeighted(q, rows[t * dim + i], w[i], sums[t][lane]);
+            } else {
+                Kernel::accumulate(q, rows[t * dim + i], sums[t][lane]);
+            }
+        }
+    };
+    size_t j = 0;
+    for (; j + Lanes <= terms; j += Lanes) {
+        for (size_t l = 0; l < Lanes; ++l) {
+            add(j + l, l);
+        }
+    }
+    for (; j < terms; ++j) {
+        add(j, 0);
+    }
+    for (size_t t = 0; t < Tile; ++t) {
+        double total[Kernel::kSums] = {};
+        for (size_t l = 0; l < Lanes; ++l) {
+            for (size_t k = 0; k < Kernel::kSums; ++k) {
+                total[k] += sums[t][l][k];
+            }
+        }
+        out[t] = Kernel::finish(total);
+    }
+}
+
+// Call `visit(index, distance)` for every row, `Tile` rows at a time
+template <typename Kernel, size_t Lanes, size_t Tile, ScanTerms Terms = ScanTerms::Plain, typename Visit>
+inline void scanTiled(const KeyspaceData& data, const double* query, size_t dim, Visit&& visit,
+                      const DimensionWeights* weights = nullptr) {
+    double distances[Tile];
+    size_t ahead = scanPrefetchRows();
+    for (size_t page = 0; page < data.pageCount(); ++page) {
+        const double* row = data.pageRows(page);
+        size_t first = data.firstRow(page);
+        size_t rows = data.rowsInPage(page);
+        size_t r = 0;
+        for (; r + Tile <= rows; r += Tile, row += Tile * dim) {
+            for (size_t t = 0; t < Tile; ++t) {
+                prefetchAhead(data, page, r + t, rows, ahead, dim);
+            }
+            tileDistances<Kernel, Lanes, Tile, Terms>(query, row, dim, distances, weights);
+            for (size_t t = 0; t < Tile; ++t) {
+                visit(first + r + t, distances[t]);
+            }
+        }
+        for (; r < rows; ++r, row += dim) {
+            prefetchAhead(data, page, r, rows, ahead, dim);
+            tileDistances<Kernel, Lanes, 1, Terms>(query, row, dim, distances, weights);
+            visit(first + r, distances[0]);
+        }
+    }
+}
+
+template <typename Kernel, size_t Lanes, size_t Tile>
+size_t scanNearestTiled(const KeyspaceData& data, const double* query, size_t dim) {
+    size_t nearest_idx = 0;
+    double min_distance = std::numeric_limits<double>::infinity();
+    scanTiled<Kernel, Lanes, Tile>(data, query, dim, [&](size_t index, double dist) {
+        if (dist < min_distance) {
+            min_distance = dist;
+            nearest_idx = index;
+        }
+    });
+    return nearest_idx;
+}
+
+template <typename Kernel, size_t Lanes, size_t Tile>
+void scanThresholdTiled(const KeyspaceData& data, const double* query, size_t dim, double threshold,
+                        std::vector<std::pair<size_t, double>>& results) {
+    scanTiled<Kernel, Lanes, Tile>(data, query, dim, [&](size_t index, double dist) {
+        double similarity = Kernel::similarity(dist);
+        if (similarity >= threshold) {
+            results.emplace_back(index, similarity);
+        }
+    });
+}
+
+// Weighted scans: the same lane/tile variants with the weights folded into
+// each term, or with only the kept dimensions visited for a mask
+template <typename Kernel, size_t Lanes, size_t Tile, typename Visit>
+inline void scanWeightedTiled(const KeyspaceData& data, const double* query, size_t dim,
+                              const DimensionWeights& weights, Visit&& visit) {
+    if (weights.isMask()) {
+        scanTiled<Kernel, Lanes, Tile, ScanTerms::Masked>(data, query, dim, visit, &weights);
+    } else {
+        scanTiled<Kernel, Lanes, Tile, ScanTerms::Weighted>(data, query, dim, visit, &weights);
+    }
+}
+
+template <typename Kernel, size_t Lanes, size_t Tile>
+size_t scanNearestWeighted(const KeyspaceData& data, const double* query, size_t dim,
+                           const DimensionWeights& weights) {
+    size_t nearest_idx = 0;
+    double min_distance = std::numeric_limits<double>::infinity();
+    scanWeightedTiled<Kernel, Lanes, Tile>(data, query, dim, weights, [&](size_t index, double dist) {
+        if (dist < min_distance) {
+            min_distance = dist;
+            nearest_idx = index;
+        }
+    });
+    return nearest_idx;
+}
+
+template <typename Kernel, size_t Lanes, size_t Tile>
+void scanThresholdWeighted(const KeyspaceData& data, const double* query, size_t dim, double threshold,
+                           const DimensionWeights& weights, std::vector<std::pair<size_t, double>>& results) {
+    scanWeightedTiled<Kernel, Lanes, Tile>(data, query, dim, weights, [&](size_t index, double dist) {
+        double similarity = Kernel::similarity(dist);
+        if (similarity >= threshold) {
+            results.emplace_back(index, similarity);
+        }
+    });
+}
+
+// Kernel that weighted searches of `Kernel` use
+template <typename Kernel>
+struct WeightedKernel {
+    using type = Kernel;
+};
+template <>
+struct WeightedKernel<UnitCosineKernel> {
+    using type = CosineKernel;
+};
+
+// Search entry points specialized for one kernel, chosen once per keyspace.
+// Weighted searches may use another kernel (see WeightedKernel) and their
+// own lane/tile variant, because calibration times them separately.
+struct SearchKernels {
+    const char* name;
+    double (*distance)(const double*, const double*, size_t);
+    size_t (*nearest)(const KeyspaceData&, const double*, size_t);
+    void (*threshold)(const KeyspaceData&, const double*, size_t, double,
+                      std::vector<std::pair<size_t, double>>&);
+    size_t lanes = 1;  // accumulators per row
+    size_t tile = 1;   // rows per pass
+    const char* weighted_name = nullptr;
+    size_t (*weighted_nearest)(const KeyspaceData&, const double*, size_t, const DimensionWeights&) = nullptr;
+    void (*weighted_threshold)(const KeyspaceData&, const double*, size_t, double, const DimensionWeights&,
+                               std::vector<std::pair<size_t, double>>&) = nullptr;
+    size_t weighted_lanes = 1;
+    size_t weighted_tile = 1;
+};
+
+// Lane and tile combinations calibration chooses from. The first is the
+// plain one-row, one-accumulator scan used when nothing was calibrated.
+struct KernelVariant {
+    size_t lanes;
+    size_t tile;
+};
+constexpr KernelVariant kKernelVariants[] = {{1, 1}, {2, 1}, {4, 1}, {8, 1}, {1, 4}, {2, 4}};
+constexpr size_t kKernelVariantCount = sizeof(kKernelVariants) / sizeof(kKernelVariants[0]);
+
+// Kernel choice table key of the weighted scans of a kernel
+inline std::string weightedKernelKey(const char* weighted_name) {
+    return std::string(weighted_name) + ":weighted";
+}
+
+template <typename Kernel, size_t Lanes, size_t Tile>
+SearchKernels tiledSearchKernels() {
+    using Weighted = typename WeightedKernel<Kernel>::type;
+    return {Kernel::kName, &Kernel::distance, &scanNearestTiled<Kernel, Lanes, Tile>,
+            &scanThresholdTiled<Kernel, Lanes, Tile>, Lanes, Tile, Weighted::kName,
+            &scanNearestWeighted<Weighted, Lanes, Tile>, &scanThresholdWeighted<Weighted, Lanes, Tile>, Lanes, Tile};
+}
+
+// Every pairing of a variant for plain searches with one for weighted
+// searches of `Kernel`: entry p * kKernelVariantCount + w pairs plain variant
+// p with weighted variant w, both in kKernelVariants order
+template <typename Kernel>
+const SearchKernels* searchKernelVariants() {
+    static const std::vector<SearchKernels> variants = [] {
+        SearchKernels plain = tiledSearchKernels<Kernel, 1, 1>();
+        plain.nearest = &scanNearest<Kernel>;
+        plain.threshold = &scanThreshold<Kernel>;
+        const SearchKernels single[kKernelVariantCount] = {
+            plain,
+            tiledSearchKernels<Kernel, 2, 1>(),
+            tiledSearchKernels<Kernel, 4, 1>(),
+            tiledSearchKernels<Kernel, 8, 1>(),
+            tiledSearchKernels<Kernel, 1, 4>(),
+            tiledSearchKernels<Kernel, 2, 4>(),
+        };
+        std::vector<SearchKernels> pairs;
+        for (const SearchKernels& p : single) {
+            for (const SearchKernels& w : single) {
+                SearchKernels pair = p;
+                pair.weighted_nearest = w.weighted_nearest;
+                pair.weighted_threshold = w.weighted_threshold;
+                pair.weighted_lanes = w.weighted_lanes;
+                pair.weighted_tile = w.weighted_tile;
+                pairs.push_back(pair);
+            }
+        }
+        return pairs;
+    }();
+    return variants.data();
+}
+
+template <typename Kernel>
+const SearchKernels& searchKernelsFor() {
+    return searchKernelVariants<Kernel>()[0];
+}
+
+// All variants of the kernel a spec searches with
+inline const SearchKernels* searchKernelVariantsFor(const KeyspaceSpec& spec) {
+    switch (spec.metric) {
+        case DistanceMetric::Euclidean:
+            return searchKernelVariants<EuclideanKernel>();
+        case DistanceMetric::Manhattan:
+            return searchKernelVariants<ManhattanKernel>();
+        case DistanceMetric::Cosine:
+            return spec.normalize ? searchKernelVariants<UnitCosineKernel>() : searchKernelVariants<CosineKernel>();
+        case DistanceMetric::InnerProduct:
+            return searchKernelVariants<InnerProductKernel>();
+    }
+    throw std::invalid_argument("Unsupported distance metric");
+}
+
+// Dimension classes calibration picks a variant for: up to 8, 32, 128, 512, and above
+constexpr size_t kDimensionClassLimits[] = {8, 32, 128, 512};
+constexpr size_t kDimensionClassCount = 5;
+
+inline size_t dimensionClass(size_t dimension) {
+    size_t c = 0;
+    while (c < kDimensionClassCount - 1 && dimension > kDimensionClassLimits[c]) {
+        ++c;
+    }
+    return c;
+}
+
+// Variant chosen per kernel name and dimension class. Immutable once
+// published; replaced wholesale by calibration and read with std::atomic_load.
+struct KernelChoiceTable {
+    std::vector<std::pair<std::string, std::array<size_t, kDimensionClassCount>>> choices;
+
+    size_t variantFor(const std::string& kernel, size_t dimension) const {
+        for (const auto& [name, variants] : choices) {
+            if (name == kernel) {
+                return variants[dimensionClass(dimension)];
+            }
+        }
+        return 0;
+    }
+};
+
+inline std::shared_ptr<const KernelChoiceTable>& kernelChoiceSlot() {
+    static std::shared_ptr<const KernelChoiceTable> table = std::make_shared<KernelChoiceTable>();
+    return table;
+}
+
+inline void publishKernelChoices(std::shared_ptr<const KernelChoiceTable> table) {
+    std::atomic_store(&kernelChoiceSlot(), std::move(table));
+}
+
+inline const SearchKernels& selectSearchKernels(const KeyspaceSpec& spec) {
+    const SearchKernels* variants = searchKernelVariantsFor(spec);
+    auto table = std::atomic_load(&kernelChoiceSlot());
+    size_t plain = table->variantFor(variants[0].name, spec.dimension);
+    size_t weighted = table->variantFor(weightedKernelKey(variants[0].weighted_name), spec.dimension);
+    return variants[plain * kKernelVariantCount + weighted];
+}
+
+#endif // DISTANCE_KERNELS_HPP
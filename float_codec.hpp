@@ -0,0 +1,179 @@
+#ifndef FLOAT_CODEC_HPP
+#define FLOAT_CODEC_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <zlib.h>
+
+#if defined(__SSE2__) || defined(__x86_64__)
+#include <emmintrin.h>
+#define FLOAT_CODEC_HAVE_SSE2 1
+#elif defined(__aarch64__)
+#include <arm_neon.h>
+#define FLOAT_CODEC_HAVE_NEON 1
+#endif
+
+// Lossless codec for segments of doubles in keyspace data files.
+//
+// Neighboring doubles rarely share whole bytes, but they usually share their
+// sign and exponent bytes. Byte shuffling regroups a segment into eight byte
+// planes (every value's byte 0, then every value's byte 1, ...) so those
+// repetitive bytes sit next to each other, and the planes are then Huffman
+// coded (zlib's Huffman-only strategy, no match search). Decoding inverts the
+// Huffman step and un-shuffles with SIMD interleaves.
+
+enum class SegmentCodec : uint32_t {
+    Raw = 0,             // plain doubles
+    ShuffleHuffman = 1,  // byte planes, Huffman coded
+};
+
+namespace float_codec_detail {
+
+constexpr size_t kPlanes = sizeof(double);
+
+inline void shuffle(const double* values, size_t count, uint8_t* planes) {
+    const uint8_t* bytes = reinterpret_cast<const uint8_t*>(values);
+    for (size_t i = 0; i < count; ++i) {
+        for (size_t b = 0; b < kPlanes; ++b) {
+            planes[b * count + i] = bytes[i * kPlanes + b];
+        }
+    }
+}
+
+inline void unshuffleScalar(const uint8_t* planes, size_t count, size_t first, uint8_t* bytes) {
+    for (size_t i = first; i < count; ++i) {
+        for (size_t b = 0; b < kPlanes; ++b) {
+            bytes[i * kPlanes + b] = planes[b * count + i];
+        }
+    }
+}
+
+// Interleave the eight planes 16 values at a time: bytes, then byte pairs,
+// then 4-byte halves are zipped together until each lane holds whole values.
+inline void unshuffle(const uint8_t* planes, size_t count, double* values) {
+    uint8_t* bytes = reinterpret_cast<uint8_t*>(values);
+    size_t i = 0;
+#if defined(FLOAT_CODEC_HAVE_SSE2)
+    for (; i + 16 <= count; i += 16) {
+        __m128i p[kPlanes];
+        for (size_t b = 0; b < kPlanes; ++b) {
+            p[b] = _mm_loadu_si128(reinterpret_cast<const __m128i*>(planes + b * count + i));
+        }
+        __m128i pairs[8];
+        for (size_t b = 0; b < 4; ++b) {
+            pairs[2 * b] = _mm_unpacklo_epi8(p[2 * b], p[2 * b + 1]);
+            pairs[2 * b + 1] = _mm_unpackhi_epi8(p[2 * b], p[2 * b + 1]);
+        }
+        // quads[h][q]: bytes 4h..4h+3 of values 4q..4q+3
+        __m128i quads[2][4];
+        for (size_t h = 0; h < 2; ++h) {
+            const __m128i* lo = &pairs[4 * h];
+            quads[h][0] = _mm_unpacklo_epi16(lo[0], lo[2]);
+            quads[h][1] = _mm_unpackhi_epi16(lo[0], lo[2]);
+            quads[h][2] = _mm_unpacklo_epi16(lo[1], lo[3]);
+            quads[h][3] = _mm_unpackhi_epi16(lo[1], lo[3]);
+        }
+        __m128i* out = reinterpret_cast<__m128i*>(bytes + i * kPlanes);
+        for (size_t q = 0; q < 4; ++q) {
+            _mm_storeu_si128(out + 2 * q, _mm_unpacklo_epi32(quads[0][q], quads[1][q]));
+            _mm_storeu_si128(out + 2 * q + 1, _mm_unpackhi_epi32(quads[0][q], quads[1][q]));
+        }
+    }
+#elif defined(FLOAT_CODEC_HAVE_NEON)
+    for (; i + 16 <= count; i += 16) {
+        uint8x16_t p[kPlanes];
+        for (size_t b = 0; b < kPlanes; ++b) {
+            p[b] = vld1q_u8(planes + b * count + i);
+        }
+        uint16x8_t pairs[8];
+        for (size_t b = 0; b < 4; ++b) {
+            pairs[2 * b] = vreinterpretq_u16_u8(vzip1q_u8(p[2 * b], p[2 * b + 1]));
+            pairs[2 * b + 1] = vreinterpretq_u16_u8(vzip2q_u8(p[2 * b], p[2 * b + 1]));
+        }
+        uint32x4_t quads[2][4];
+        for (size_t h = 0; h < 2; ++h) {
+            const uint16x8_t* lo = &pairs[4 * h];
+            quads[h][0] = vreinterpretq_u32_u16(vzip1q_u16(lo[0], lo[2]));
+            quads[h][1] = vreinterpretq_u32_u16(vzip2q_u16(lo[0], lo[2]));
+            quads[h][2] = vreinterpretq_u32_u16(vzip1q_u16(lo[1], lo[3]));
+            quads[h][3] = vreinterpretq_u32_u16(vzip2q_u16(lo[1], lo[3]));
+        }
+        uint8_t* out = bytes + i * kPlanes;
+        for (size_t q = 0; q < 4; ++q) {
+            vst1q_u8(out + 32 * q, vreinterpretq_u8_u32(vzip1q_u32(quads[0][q], quads[1][q])));
+            vst1q_u8(out + 32 * q + 16, vreinterpretq_u8_u32(vzip2q_u32(quads[0][q], quads[1][q])));
+        }
+    }
+#endif
+    unshuffleScalar(planes, count, i, bytes);
+}
+
+}  // namespace float_codec_detail
+
+// Encode `count` doubles. Uses `preferred` unless it would not make the
+// segment smaller, in which case the values are stored raw; `used` reports
+// which codec the returned bytes are in.
+inline std::string encodeFloatSegment(const double* values, size_t count, SegmentCodec preferred, SegmentCodec& used) {
+    size_t raw_bytes = count * sizeof(double);
+    if (preferred == SegmentCodec::ShuffleHuffman && count > 0) {
+        std::vector<uint8_t> planes(raw_bytes);
+        float_codec_detail::shuffle(values, count, planes.data());
+
+        z_stream zs{};
+        // Raw deflate stream (negative window bits): segments carry their own CRC
+        if (deflateInit2(&zs, 1, Z_DEFLATED, -15, 8, Z_HUFFMAN_ONLY) != Z_OK) {
+            throw std::runtime_error("Failed to initialize segment encoder");
+        }
+        std::string encoded(deflateBound(&zs, static_cast<uLong>(raw_bytes)), '\0');
+        zs.next_in = planes.data();
+        zs.avail_in = static_cast<uInt>(raw_bytes);
+        zs.next_out = reinterpret_cast<Bytef*>(&encoded[0]);
+        zs.avail_out = static_cast<uInt>(encoded.size());
+        int status = deflate(&zs, Z_FINISH);
+        encoded.resize(zs.total_out);
+        deflateEnd(&zs);
+        if (status == Z_STREAM_END && encoded.size() < raw_bytes) {
+            used = SegmentCodec::ShuffleHuffman;
+            return encoded;
+        }
+    }
+    used = SegmentCodec::Raw;
+    return std::string(reinterpret_cast<const char*>(values), raw_bytes);
+}
+
+// Decode a segment of `count` doubles written by encodeFloatSegment
+inline void decodeFloatSegment(const char* bytes, size_t size, SegmentCodec codec, double* values, size_t count) {
+    size_t raw_bytes = count * sizeof(double);
+    if (codec == SegmentCodec::Raw) {
+        if (size != raw_bytes) {
+            throw std::runtime_error("Segment size does not match its row count");
+        }
+        std::memcpy(values, bytes, raw_bytes);
+        return;
+    }
+    if (codec != SegmentCodec::ShuffleHuffman) {
+        throw std::runtime_error("Unknown segment codec");
+    }
+    std::vector<uint8_t> planes(raw_bytes);
+    z_stream zs{};
+    if (inflateInit2(&zs, -15) != Z_OK) {
+        throw std::runtime_error("Failed to initialize segment decoder");
+    }
+    zs.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(bytes));
+    zs.avail_in = static_cast<uInt>(size);
+    zs.next_out = planes.data();
+    zs.avail_out = static_cast<uInt>(raw_bytes);
+    int status = inflate(&zs, Z_FINISH);
+    bool complete = status == Z_STREAM_END && zs.total_out == raw_bytes;
+    inflateEnd(&zs);
+    if (!complete) {
+        throw std::runtime_error("Corrupt compressed segment");
+    }
+    float_codec_detail::unshuffle(planes.data(), count, values);
+}
+
+#endif // FLOAT_CODEC_HPP
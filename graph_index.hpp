@@ -0,0 +1,400 @@
+#ifndef GRAPH_INDEX_HPP
+#define GRAPH_INDEX_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <memory_resource>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+#include "distance_kernels.hpp"
+#include "keyspace_spec.hpp"
+#include "keyspace_storage.hpp"
+#include "norm_augmentation.hpp"
+#include "prefetch.hpp"
+#include "scratch_arena.hpp"
+#include "visited_table.hpp"
+
+// Proximity graph over the rows of a keyspace, for approximate nearest
+// neighbor search on IndexType::Graph keyspaces.
+//
+// Rows are inserted one at a time: each one runs a beam search over the rows
+// inserted before it, links to `degree` of the closest rows it found and
+// adds itself to their lists, which are trimmed back to their closest
+// 2 * `degree` (see GraphIndexParams in keyspace_spec.hpp). Queries run the
+// same beam search from an entry row close to the centroid.
+//
+// A graph is immutable once published. Rows appended to the keyspace later
+// are inserted into a copy made by extendedTo, which shares the node blocks
+// it does not touch with the original, so growing a graph costs the
+// insertions rather than a rebuild. A graph covers rows [0, size()) of the
+// data version it was last extended to and pins that version, so row
+// pointers stay valid for the graph's lifetime. Removing or updating rows
+// renumbers or moves them; the graph has to be rebuilt after that.
+//
+// Every hop is a cache miss on rows the hardware cannot predict, so the
+// search hides them itself: it prefetches the link list of the node it will
+// expand next, the visited slots of all neighbors before testing them, and
+// the vectors of the next few unvisited neighbors while computing the current
+// one (see prefetch.hpp).
+//
+// Inner product is not a distance a graph can be navigated by, so for
+// InnerProduct keyspaces the graph is built and searched in the Euclidean
+// space of norm-augmented rows (see norm_augmentation.hpp). The extra
+// coordinate is kept per row rather than copying the data.
+
+constexpr size_t kGraphBlockNodes = 32;      // nodes per copy-on-write block
+constexpr size_t kGraphPublishRows = 16384;  // rows a long build inserts before it first publishes
+constexpr std::chrono::milliseconds kGraphBuilderLinger{1000};  // idle time before a builder thread exits
+
+// What one traversal did
+struct GraphSearchStats {
+    size_t nodes_expanded = 0;
+    size_t distance_evaluations = 0;
+};
+
+class GraphIndex {
+private:
+    using Candidate = std::pair<double, uint32_t>;  // distance, row
+
+    struct Block {
+        const double* rows[kGraphBlockNodes];  // row pointers, so traversal skips the page lookup
+        double extra[kGraphBlockNodes];        // augmentation coordinate; 0 unless InnerProduct
+        uint32_t degrees[kGraphBlockNodes];
+        std::vector<uint32_t> links;           // max_degree slots per node
+    };
+
+    std::shared_ptr<const KeyspaceData> data;
+    size_t dimension;
+    double (*distance)(const double*, const double*, size_t);
+    GraphIndexParams params;
+    size_t max_degree;  // 2 * params.degree
+    bool augmented = false;
+    NormAugmentation augmentation;
+    std::vector<std::shared_ptr<Block>> blocks;
+    size_t nodes = 0;
+    uint32_t entry = 0;
+    size_t entry_nodes = 0;       // nodes when `entry` was picked
+    std::vector<bool> writable;   // blocks this copy owns while it is being extended
+
+    const Block& block(uint32_t node) const { return *blocks[node / kGraphBlockNodes]; }
+    const double* row(uint32_t node) const { return block(node).rows[node % kGraphBlockNodes]; }
+    double extraOf(uint32_t node) const { return block(node).extra[node % kGraphBlockNodes]; }
+    uint32_t degreeOf(uint32_t node) const { return block(node).degrees[node % kGraphBlockNodes]; }
+
+    const uint32_t* neighbors(uint32_t node) const {
+        return block(node).links.data() + (node % kGraphBlockNodes) * max_degree;
+    }
+
+    // Block holding `node`, copied first if it is still shared with another graph
+    Block& mutableBlock(uint32_t node) {
+        size_t index = node / kGraphBlockNodes;
+        if (!writable[index]) {
+            blocks[index] = std::make_shared<Block>(*blocks[index]);
+            writable[index] = true;
+        }
+        return *blocks[index];
+    }
+
+    // Distance from a point whose augmentation coordinate is `point_extra`
+    // (0 for queries) to row `node`
+    double distanceTo(const double* point, double point_extra, uint32_t node) const {
+        double d = distance(point, row(node), dimension);
+        if (!augmented) {
+            return d;
+        }
+        double e = point_extra - extraOf(node);
+        return std::sqrt(d * d + e * e);
+    }
+
+    double between(uint32_t a, uint32_t b) const {
+        return distanceTo(row(a), extraOf(a), b);
+    }
+
+    // Beam search over rows [0, limit) from `start`; leaves the closest
+    // `width` rows in `results` as a max-heap on distance
+    void beamSearch(const double* query, double query_extra, size_t limit, uint32_t start, size_t width,
+                    std::pmr::vector<Candidate>& results, std::pmr::memory_resource* memory,
+                    GraphSearchStats& stats) const {
+        VisitedTable& visited = threadVisitedTable();
+        visited.begin(limit);
+        size_t ahead = graphPrefetchNeighbors();
+        uint32_t unvisited[2 * kGraphDegreeLimit];
+        std::pmr::vector<Candidate> frontier(memory);  // min-heap on distance
+        auto closer = std::greater<Candidate>();
+
+        double d = distanceTo(query, query_extra, start);
+        ++stats.distance_evaluations;
+        visited.visit(start);
+        frontier.emplace_back(d, start);
+        results.emplace_back(d, start);
+        while (!frontier.empty()) {
+            std::pop_heap(frontier.begin(), frontier.end(), closer);
+            Candidate current = frontier.back();
+            frontier.pop_back();
+            if (results.size() >= width && current.first > results.front().first) {
+                break;  // nothing left in the frontier can improve the results
+            }
+            if (ahead > 0 && !frontier.empty()) {
+                prefetchRead(neighbors(frontier.front().second));  // next node to expand
+            }
+            ++stats.nodes_expanded;
+            const uint32_t* list = neighbors(current.second);
+            uint32_t degree = degreeOf(current.second);
+            if (ahead > 0) {
+                for (uint32_t i = 0; i < degree; ++i) {
+                    visited.prefetch(list[i]);
+                }
+            }
+            size_t count = 0;
+            for (uint32_t i = 0; i < degree; ++i) {
+                if (list[i] < limit && visited.visit(list[i])) {
+                    unvisited[count++] = list[i];
+                }
+            }
+            for (size_t i = 0; i < std::min(ahead, count); ++i) {
+                prefetchRow(row(unvisited[i]), dimension);
+            }
+            for (size_t i = 0; i < count; ++i) {
+                if (ahead > 0 && i + ahead < count) {
+                    prefetchRow(row(unvisited[i + ahead]), dimension);
+                }
+                uint32_t next = unvisited[i];
+                double dist = distanceTo(query, query_extra, next);
+                ++stats.distance_evaluations;
+                if (results.size() < width || dist < results.front().first) {
+                    frontier.emplace_back(dist, next);
+                    std::push_heap(frontier.begin(), frontier.end(), closer);
+                    results.emplace_back(dist, next);
+                    std::push_heap(results.begin(), results.end());
+                    if (results.size() > width) {
+                        std::pop_heap(results.begin(), results.end());
+                        results.pop_back();
+                    }
+                }
+            }
+        }
+    }
+
+    // Up to `limit` of `closest` (distances to one row, nearest first),
+    // preferring candidates that are closer to that row than to any candidate
+    // already picked. That keeps links into neighboring clusters that plain
+    // nearest selection would crowd out, which is what lets searches cross
+    // between them.
+    std::pmr::vector<uint32_t> selectNeighbors(const std::pmr::vector<Candidate>& closest, size_t limit,
+                                               std::pmr::memory_resource* memory) const {
+        std::pmr::vector<uint32_t> picked(memory);
+        std::pmr::vector<uint32_t> skipped(memory);
+        for (const Candidate& candidate : closest) {
+            if (picked.size() == limit) {
+                break;
+            }
+            bool diverse = true;
+            for (uint32_t other : picked) {
+                if (between(candidate.second, other) < candidate.first) {
+                    diverse = false;
+                    break;
+                }
+            }
+            (diverse ? picked : skipped).push_back(candidate.second);
+        }
+        for (size_t i = 0; i < skipped.size() && picked.size() < limit; ++i) {
+            picked.push_back(skipped[i]);
+        }
+        return picked;
+    }
+
+    void link(uint32_t from, uint32_t to, std::pmr::memory_resource* memory) {
+        Block& target = mutableBlock(from);
+        size_t slot = from % kGraphBlockNodes;
+        uint32_t* list = target.links.data() + slot * max_degree;
+        uint32_t& degree = target.degrees[slot];
+        if (degree < max_degree) {
+            list[degree++] = to;
+            return;
+        }
+        // Full: reselect from the current links and `to` by the same rule
+        std::pmr::vector<Candidate> candidates(memory);
+        candidates.emplace_back(between(from, to), to);
+        for (uint32_t i = 0; i < max_degree; ++i) {
+            candidates.emplace_back(between(from, list[i]), list[i]);
+        }
+        std::sort(candidates.begin(), candidates.end());
+        std::pmr::vector<uint32_t> kept = selectNeighbors(candidates, max_degree, memory);
+        std::copy(kept.begin(), kept.end(), list);
+        degree = static_cast<uint32_t>(kept.size());
+    }
+
+    void pickEntry() {
+        std::vector<double> centroid(dimension, 0.0);
+        double centroid_extra = 0.0;
+        for (uint32_t node = 0; node < nodes; ++node) {
+            const double* values = row(node);
+            for (size_t i = 0; i < dimension; ++i) {
+                centroid[i] += values[i];
+            }
+            centroid_extra += extraOf(node);
+        }
+        for (double& value : centroid) {
+            value /= static_cast<double>(nodes);
+        }
+        centroid_extra /= static_cast<double>(nodes);
+        double best = std::numeric_limits<double>::infinity();
+        for (uint32_t node = 0; node < nodes; ++node) {
+            double d = distanceTo(centroid.data(), centroid_extra, node);
+            if (d < best) {
+                best = d;
+                entry = node;
+            }
+        }
+        entry_nodes = nodes;
+    }
+
+    // Point rows [0, nodes) into `source`, which holds the same rows: pages
+    // replaced since `data` (a tail page copied when it was shared) are
+    // pointed into again
+    void repoint(const KeyspaceData& source) {
+        const PageTable& before = *data->table;
+        const PageTable& after = *source.table;
+        if (&before == &after) {
+            return;
+        }
+        for (size_t page = 0; page < std::min(before.pageCount(), after.pageCount()); ++page) {
+            if (before.page(page) == after.page(page)) {
+                continue;
+            }
+            size_t first = after.firstRow(page);
+            size_t end = std::min(nodes, first + source.rowsInPage(page));
+            for (size_t node = first; node < end; ++node) {
+                mutableBlock(static_cast<uint32_t>(node)).rows[node % kGraphBlockNodes] =
+                    after.page(page)->row(node - first);
+            }
+        }
+    }
+
+    // Insert rows [nodes, end) of `data`. Stops early when `cancel` is set.
+    void insertRows(size_t end, const std::atomic<bool>* cancel) {
+        size_t needed = (end + kGraphBlockNodes - 1) / kGraphBlockNodes;
+        while (blocks.size() < needed) {
+            auto fresh = std::make_shared<Block>();
+            fresh->links.resize(kGraphBlockNodes * max_degree);
+            blocks.push_back(std::move(fresh));
+            writable.push_back(true);
+        }
+        GraphSearchStats stats;
+        for (uint32_t node = static_cast<uint32_t>(nodes); node < end; ++node) {
+            if (cancel && cancel->load(std::memory_order_relaxed)) {
+                break;
+            }
+            Block& target = mutableBlock(node);
+            size_t slot = node % kGraphBlockNodes;
+            target.rows[slot] = data->row(node);
+            target.extra[slot] = augmented ? augmentation.extraCoordinate(target.rows[slot], dimension) : 0.0;
+            target.degrees[slot] = 0;
+            if (node > 0) {
+                ScratchArena::Scope scratch(threadScratch());
+                std::pmr::vector<Candidate> closest(scratch.memory());
+                beamSearch(target.rows[slot], target.extra[slot], node, entry, params.build_width, closest,
+                           scratch.memory(), stats);
+                std::sort(closest.begin(), closest.end());
+                for (uint32_t neighbor : selectNeighbors(closest, params.degree, scratch.memory())) {
+                    link(node, neighbor, scratch.memory());
+                    link(neighbor, node, scratch.memory());
+                }
+            }
+            nodes = node + 1;
+            if (nodes >= 2 * entry_nodes) {
+                pickEntry();  // re-picked as the graph doubles, so amortized O(1) per row
+            }
+        }
+        writable.clear();
+    }
+
+public:
+    // Graph over the first `end` rows of `source` (all rows by default). A
+    // set `cancel` stops the build early, leaving a graph over fewer rows.
+    GraphIndex(std::shared_ptr<const KeyspaceData> source, const KeyspaceSpec& spec, const SearchKernels& kernels,
+               size_t end = SIZE_MAX, const std::atomic<bool>* cancel = nullptr)
+        : data(std::move(source)), dimension(spec.dimension), distance(kernels.distance), params(spec.graph),
+          max_degree(2 * static_cast<size_t>(spec.graph.degree)) {
+        if (data->count > std::numeric_limits<uint32_t>::max()) {
+            throw std::runtime_error("Keyspace too large for a graph index");
+        }
+        if (spec.metric == DistanceMetric::InnerProduct) {
+            distance = &EuclideanKernel::distance;
+            augmented = true;
+            augmentation = NormAugmentation::fit(*data, dimension);
+        }
+        insertRows(std::min(end, data->count), cancel);
+    }
+
+    // Copy of this graph extended to the first `end` rows of `source`, a later
+    // version of the same keyspace that only appended rows since this graph's
+    // version. Null when a new row is longer than the norm augmentation was
+    // fitted to, which needs a rebuild.
+    std::shared_ptr<const GraphIndex> extendedTo(std::shared_ptr<const KeyspaceData> source, size_t end = SIZE_MAX,
+                                                 const std::atomic<bool>* cancel = nullptr) const {
+        if (source->count > std::numeric_limits<uint32_t>::max()) {
+            throw std::runtime_error("Keyspace too large for a graph index");
+        }
+        end = std::min(end, source->count);
+        if (augmented) {
+            for (size_t r = nodes; r < end; ++r) {
+                if (NormAugmentation::squaredNorm(source->row(r), dimension) > augmentation.max_squared_norm) {
+                    return nullptr;
+                }
+            }
+        }
+        auto extended = std::make_shared<GraphIndex>(*this);
+        extended->writable.assign(blocks.size(), false);
+        extended->repoint(*source);
+        extended->data = std::move(source);
+        extended->insertRows(end, cancel);
+        return extended;
+    }
+
+    // Version of the data the graph's rows come from
+    uint64_t getVersion() const { return data->version; }
+    // Last version that removed or updated rows; the graph is valid for
+    // versions from then on, up to the next one that does
+    uint64_t getRewrittenVersion() const { return data->rewritten_version; }
+    // Rows covered: [0, size())
+    size_t size() const { return nodes; }
+    const GraphIndexParams& getParams() const { return params; }
+
+    // Average links per row
+    double averageDegree() const {
+        if (nodes == 0) {
+            return 0.0;
+        }
+        size_t total = 0;
+        for (uint32_t node = 0; node < nodes; ++node) {
+            total += degreeOf(node);
+        }
+        return static_cast<double>(total) / nodes;
+    }
+
+    // Approximate nearest of rows [0, limit) to `query`; searching wider
+    // trades speed for recall
+    size_t findNearest(const double* query, size_t limit, size_t width, GraphSearchStats* stats = nullptr) const {
+        limit = std::min(limit, nodes);
+        if (limit == 0) {
+            throw std::runtime_error("Vector store is empty");
+        }
+        ScratchArena::Scope scratch(threadScratch());
+        std::pmr::vector<Candidate> closest(scratch.memory());
+        GraphSearchStats local;
+        beamSearch(query, 0.0, limit, entry < limit ? entry : 0, std::max<size_t>(width, 1), closest,
+                   scratch.memory(), stats ? *stats : local);
+        return std::min_element(closest.begin(), closest.end())->second;
+    }
+};
+
+#endif // GRAPH_INDEX_HPP
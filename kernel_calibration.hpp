@@ -0,0 +1,228 @@
+#ifndef KERNEL_CALIBRATION_HPP
+#define KERNEL_CALIBRATION_HPP
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <fstream>
+#include <limits>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <spdlog/spdlog.h>
+#include "cpu_info.hpp"
+#include "dataset_generator.hpp"
+#include "dimension_weights.hpp"
+#include "distance_kernels.hpp"
+#include "keyspace_spec.hpp"
+#include "keyspace_storage.hpp"
+
+// Startup calibration of the scan variants in distance_kernels.hpp.
+//
+// For every kernel and dimension class, each lane/tile variant scans a small
+// cache-resident keyspace repeatedly, once for plain and once for weighted
+// nearest searches, which are chosen separately; the fastest wins, but only if it beats
+// the plain scan by a margin, so measurement noise never swaps variants back
+// and forth between starts. The choices are cached in a small text file keyed
+// by a CPU signature (model, SIMD flags, compiled SIMD level) and reused as
+// long as the signature matches.
+//
+// Cache layout:
+//   vector_store_kernel_calibration <version>
+//   signature <cpu signature>
+//   <kernel name> <variant per dimension class>...
+//   <weighted kernel name>:weighted <variant per dimension class>...
+
+constexpr int kCalibrationFormatVersion = 2;
+constexpr double kCalibrationMinGain = 0.03;  // required speedup over the plain scan
+
+inline std::string cpuSignature() {
+    std::string signature = readCpuModel() + "|" + compiledSimd() + "|";
+    for (const auto& flag : detectCpuFlags()) {
+        signature += flag + ",";
+    }
+    return signature;
+}
+
+namespace calibration_detail {
+
+// Dimension measured for each class
+constexpr size_t kClassDimensions[kDimensionClassCount] = {8, 32, 128, 512, 1024};
+constexpr size_t kWorkingSetBytes = 512 << 10;
+constexpr int kRepetitions = 3;
+constexpr double kMinRunSeconds = 0.002;
+
+// Best-of-kRepetitions nanoseconds per row of one variant's nearest scan,
+// weighted by `weights` when given
+inline double measure(const SearchKernels& kernels, const KeyspaceData& data, const double* query, size_t dim,
+                      const DimensionWeights* weights = nullptr) {
+    using Clock = std::chrono::steady_clock;
+    double best = std::numeric_limits<double>::infinity();
+    volatile size_t sink = 0;
+    for (int rep = 0; rep < kRepetitions; ++rep) {
+        size_t scans = 0;
+        auto start = Clock::now();
+        double elapsed = 0.0;
+        do {
+            sink = sink + (weights ? kernels.weighted_nearest(data, query, dim, *weights)
+                                   : kernels.nearest(data, query, dim));
+            ++scans;
+            elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+        } while (elapsed < kMinRunSeconds);
+        best = std::min(best, elapsed * 1e9 / (scans * data.count));
+    }
+    return best;
+}
+
+inline std::shared_ptr<const KernelChoiceTable> readCache(const std::string& path, const std::string& signature) {
+    std::ifstream in(path);
+    if (!in) {
+        return nullptr;
+    }
+    std::string magic, key, line;
+    int version = 0;
+    if (!(in >> magic >> version) || magic != "vector_store_kernel_calibration" ||
+        version != kCalibrationFormatVersion) {
+        return nullptr;
+    }
+    std::getline(in, line);
+    if (!std::getline(in, line) || line != "signature " + signature) {
+        return nullptr;
+    }
+    auto table = std::make_shared<KernelChoiceTable>();
+    while (std::getline(in, line)) {
+        std::istringstream fields(line);
+        std::string name;
+        std::array<size_t, kDimensionClassCount> variants{};
+        if (!(fields >> name)) {
+            continue;
+        }
+        for (size_t& v : variants) {
+            if (!(fields >> v) || v >= kKernelVariantCount) {
+                return nullptr;
+            }
+        }
+        table->choices.emplace_back(name, variants);
+    }
+    return table;
+}
+
+inline void writeCache(const std::string& path, const std::string& signature, const KernelChoiceTable& table) {
+    std::ofstream out(path, std::ios::trunc);
+    if (!out) {
+        spdlog::warn("Failed to write kernel calibration cache: {}", path);
+        return;
+    }
+    out << "vector_store_kernel_calibration " << kCalibrationFormatVersion << "\n";
+    out << "signature " << signature << "\n";
+    for (const auto& [name, variants] : table.choices) {
+        out << name;
+        for (size_t v : variants) {
+            out << " " << v;
+        }
+        out << "\n";
+    }
+}
+
+}  // namespace calibration_detail
+
+// Measure every kernel variant on this CPU
+inline std::shared_ptr<KernelChoiceTable> measureKernelChoices() {
+    KeyspaceSpec specs[5];
+    specs[0].metric = DistanceMetric::Euclidean;
+    specs[1].metric = DistanceMetric::Manhattan;
+    specs[2].metric = DistanceMetric::Cosine;
+    specs[2].normalize = false;
+    specs[3].metric = DistanceMetric::Cosine;
+    specs[3].normalize = true;
+    specs[4].metric = DistanceMetric::InnerProduct;
+
+    auto table = std::make_shared<KernelChoiceTable>();
+    for (const KeyspaceSpec& spec : specs) {
+        const SearchKernels* variants = searchKernelVariantsFor(spec);
+        // Normalized cosine weights through the plain cosine kernel, which is measured once
+        std::string weighted_key = weightedKernelKey(variants[0].weighted_name);
+        bool weighted_measured = std::any_of(table->choices.begin(), table->choices.end(),
+                                             [&](const auto& choice) { return choice.first == weighted_key; });
+        std::array<size_t, kDimensionClassCount> chosen{};
+        std::array<size_t, kDimensionClassCount> weighted_chosen{};
+        for (size_t c = 0; c < kDimensionClassCount; ++c) {
+            size_t dim = calibration_detail::kClassDimensions[c];
+            DatasetSpec dataset;
+            dataset.dimension = dim;
+            dataset.count = std::max<size_t>(256, calibration_detail::kWorkingSetBytes / (dim * sizeof(double))) + 1;
+            dataset.distribution = DatasetDistribution::Normalized;
+            std::vector<double> values = generateDataset(dataset, 1);
+
+            KeyspaceData empty;
+            KeyspaceDataBuilder builder(empty, dim);
+            for (size_t i = 1; i < dataset.count; ++i) {
+                builder.append(values.data() + i * dim);
+            }
+            auto data = builder.build();
+            const double* query = values.data();  // row 0 is kept out of the data
+
+            // Variant v for plain searches sits at v * kKernelVariantCount, for weighted ones at v
+            auto pick = [&](const DimensionWeights* weights, size_t stride, const char* label) {
+                double baseline = calibration_detail::measure(variants[0], *data, query, dim, weights);
+                double best = baseline;
+                size_t choice = 0;
+                for (size_t v = 1; v < kKernelVariantCount; ++v) {
+                    double ns = calibration_detail::measure(variants[v * stride], *data, query, dim, weights);
+                    if (ns < best && ns < baseline * (1.0 - kCalibrationMinGain)) {
+                        best = ns;
+                        choice = v;
+                    }
+                }
+                spdlog::info("Calibrated {}{} kernel at {} dimensions: {} lanes x {} rows per pass, {:.2f} ns/row "
+                             "(plain scan {:.2f})", label, weights ? variants[0].weighted_name : variants[0].name,
+                             dim, kKernelVariants[choice].lanes, kKernelVariants[choice].tile, best, baseline);
+                return choice;
+            };
+            chosen[c] = pick(nullptr, kKernelVariantCount, "");
+            if (!weighted_measured) {
+                std::vector<double> weights(dim);
+                for (size_t i = 0; i < dim; ++i) {
+                    weights[i] = 0.5 + 0.25 * static_cast<double>(i % 4);
+                }
+                DimensionWeights scaled(std::move(weights));
+                weighted_chosen[c] = pick(&scaled, 1, "weighted ");
+            }
+        }
+        table->choices.emplace_back(variants[0].name, chosen);
+        if (!weighted_measured) {
+            table->choices.emplace_back(weighted_key, weighted_chosen);
+        }
+    }
+    return table;
+}
+
+// Load the cached choices for this CPU from `cache_path`, or measure them
+// and write the cache, then publish them for keyspaces created afterwards.
+// An empty path measures without caching; `force` ignores any cache.
+inline std::shared_ptr<const KernelChoiceTable> calibrateSearchKernels(const std::string& cache_path,
+                                                                        bool force = false) {
+    std::string signature = cpuSignature();
+    std::shared_ptr<const KernelChoiceTable> table;
+    if (!cache_path.empty() && !force) {
+        table = calibration_detail::readCache(cache_path, signature);
+        if (table) {
+            spdlog::info("Using kernel calibration from {}", cache_path);
+        }
+    }
+    if (!table) {
+        auto start = std::chrono::steady_clock::now();
+        auto measured = measureKernelChoices();
+        spdlog::info("Kernel calibration took {:.2f}s",
+                     std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+        if (!cache_path.empty()) {
+            calibration_detail::writeCache(cache_path, signature, *measured);
+        }
+        table = measured;
+    }
+    publishKernelChoices(table);
+    return table;
+}
+
+#endif // KERNEL_CALIBRATION_HPP
@@ -0,0 +1,312 @@
+#ifndef KEYSPACE_EXPORT_HPP
+#define KEYSPACE_EXPORT_HPP
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+#include <zlib.h>
+#include "keyspace_spec.hpp"
+#include "keyspace_storage.hpp"
+#include "storage_format.hpp"
+
+// Streaming export of one keyspace version for backups and offline tools.
+//
+// Binary (.vsx) layout:
+//   u32 magic, u32 version, string name, spec, u64 count, u64 data version,
+//   then count * dimension doubles in row order (a row's key is its index).
+//
+// Npy (.npy) is a standard NumPy v1.0 array of shape (count, dimension) and
+// dtype <f8, loadable with numpy.load; it carries no keyspace metadata.
+//
+// Either format can be gzip-compressed. Rows are copied page by page into
+// large chunks, and every chunk is charged to an optional rate limiter before
+// it is written, so a backup can run next to serving traffic. Imports read
+// the rows back in chunks of the same kind.
+
+constexpr uint32_t kExportMagic = 0x58535356;  // "VSSX"
+constexpr uint32_t kExportFormatVersion = 1;
+
+enum class ExportFormat {
+    Binary,
+    Npy,
+};
+
+struct ExportOptions {
+    ExportFormat format = ExportFormat::Binary;
+    bool compress = false;               // gzip the output stream
+    int compression_level = 6;           // zlib level, 1 (fast) .. 9 (small)
+    uint64_t max_bytes_per_second = 0;   // limit on bytes written to disk, 0 = unlimited
+    size_t chunk_bytes = 4 << 20;        // size of each sequential write
+};
+
+struct ExportStats {
+    uint64_t rows = 0;
+    uint64_t raw_bytes = 0;      // bytes before compression
+    uint64_t written_bytes = 0;  // bytes written to the file
+};
+
+// Token bucket over bytes. The bucket holds at most one second of budget, so
+// the long-run rate never exceeds `bytes_per_second` by more than one burst.
+class IoRateLimiter {
+private:
+    using Clock = std::chrono::steady_clock;
+
+    uint64_t bytes_per_second;
+    double tokens;
+    Clock::time_point last_refill;
+
+public:
+    explicit IoRateLimiter(uint64_t bytes_per_second)
+        : bytes_per_second(bytes_per_second), tokens(static_cast<double>(bytes_per_second)),
+          last_refill(Clock::now()) {}
+
+    // Block until `bytes` may be written
+    void acquire(size_t bytes) {
+        if (bytes_per_second == 0) {
+            return;
+        }
+        Clock::time_point now = Clock::now();
+        double elapsed = std::chrono::duration<double>(now - last_refill).count();
+        last_refill = now;
+        tokens = std::min<double>(tokens + elapsed * bytes_per_second, static_cast<double>(bytes_per_second));
+        tokens -= static_cast<double>(bytes);
+        if (tokens < 0) {
+            std::this_thread::sleep_for(std::chrono::duration<double>(-tokens / bytes_per_second));
+        }
+    }
+};
+
+// Buffered, optionally gzip-compressed and rate-limited output file
+class ExportWriter {
+private:
+    std::ofstream out;
+    std::string path;
+    bool compress;
+    size_t chunk_bytes;
+    IoRateLimiter limiter;
+    z_stream zs{};
+    std::vector<char> pending;     // uncompressed bytes not yet handed on
+    std::vector<char> compressed;  // deflate output buffer
+    ExportStats& stats;
+
+    void writeOut(const char* bytes, size_t size) {
+        limiter.acquire(size);
+        out.write(bytes, size);
+        if (!out) {
+            throw std::runtime_error("Failed to write export file: " + path);
+        }
+        stats.written_bytes += size;
+    }
+
+    void deflateChunk(const char* bytes, size_t size, int flush) {
+        zs.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(bytes));
+        zs.avail_in = static_cast<uInt>(size);
+        do {
+            zs.next_out = reinterpret_cast<Bytef*>(compressed.data());
+            zs.avail_out = static_cast<uInt>(compressed.size());
+            if (deflate(&zs, flush) == Z_STREAM_ERROR) {
+                throw std::runtime_error("Failed to compress export file: " + path);
+            }
+            writeOut(compressed.data(), compressed.size() - zs.avail_out);
+        } while (zs.avail_out == 0);
+    }
+
+    void flushPending(int flush) {
+        if (compress) {
+            deflateChunk(pending.data(), pending.size(), flush);
+        } else if (!pending.empty()) {
+            writeOut(pending.data(), pending.size());
+        }
+        pending.clear();
+    }
+
+public:
+    ExportWriter(const std::string& path, const ExportOptions& options, ExportStats& stats)
+        : out(path, std::ios::binary | std::ios::trunc), path(path), compress(options.compress),
+          chunk_bytes(std::max<size_t>(options.chunk_bytes, 4096)), limiter(options.max_bytes_per_second),
+          stats(stats) {
+        if (!out) {
+            throw std::runtime_error("Failed to open export file for writing: " + path);
+        }
+        pending.reserve(chunk_bytes);
+        if (compress) {
+            compressed.resize(chunk_bytes);
+            // windowBits + 16 selects a gzip wrapper, so `gunzip` can read the file
+            if (deflateInit2(&zs, options.compression_level, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+                throw std::runtime_error("Failed to initialize compression for: " + path);
+            }
+        }
+    }
+
+    ~ExportWriter() {
+        if (compress) {
+            deflateEnd(&zs);
+        }
+    }
+
+    ExportWriter(const ExportWriter&) = delete;
+    ExportWriter& operator=(const ExportWriter&) = delete;
+
+    void write(const void* bytes, size_t size) {
+        const char* data = static_cast<const char*>(bytes);
+        stats.raw_bytes += size;
+        while (size > 0) {
+            size_t take = std::min(size, chunk_bytes - pending.size());
+            pending.insert(pending.end(), data, data + take);
+            data += take;
+            size -= take;
+            if (pending.size() == chunk_bytes) {
+                flushPending(Z_NO_FLUSH);
+            }
+        }
+    }
+
+    void finish() {
+        flushPending(compress ? Z_FINISH : Z_NO_FLUSH);
+        out.flush();
+        if (!out) {
+            throw std::runtime_error("Failed to write export file: " + path);
+        }
+    }
+};
+
+inline std::string npyHeader(uint64_t count, uint64_t dimension) {
+    std::string dict = "{'descr': '<f8', 'fortran_order': False, 'shape': (" +
+                       std::to_string(count) + ", " + std::to_string(dimension) + "), }";
+    // magic (6) + version (2) + header length (2) + dict, padded to 64 bytes and ended by '\n'
+    size_t total = 10 + dict.size() + 1;
+    dict.append((64 - total % 64) % 64, ' ');
+    dict.push_back('\n');
+    std::string header("\x93NUMPY\x01\x00", 8);
+    uint16_t length = static_cast<uint16_t>(dict.size());
+    header.append(reinterpret_cast<const char*>(&length), sizeof(length));
+    return header + dict;
+}
+
+// Export the rows of `data` to `path`
+inline ExportStats exportKeyspaceData(const KeyspaceData& data, const KeyspaceSpec& spec, const std::string& name,
+                                      const std::string& path, const ExportOptions& options = {}) {
+    ExportStats stats;
+    ExportWriter writer(path, options, stats);
+    if (options.format == ExportFormat::Npy) {
+        std::string header = npyHeader(data.count, spec.dimension);
+        writer.write(header.data(), header.size());
+    } else {
+        std::ostringstream header;
+        writePod(header, kExportMagic);
+        writePod(header, kExportFormatVersion);
+        writeString(header, name);
+        writeSpec(header, spec);
+        writePod<uint64_t>(header, data.count);
+        writePod<uint64_t>(header, data.version);
+        std::string bytes = header.str();
+        writer.write(bytes.data(), bytes.size());
+    }
+    for (size_t page = 0; page < data.pageCount(); ++page) {
+        writer.write(data.pageRows(page), data.rowsInPage(page) * spec.dimension * sizeof(double));
+    }
+    writer.finish();
+    stats.rows = data.count;
+    return stats;
+}
+
+// Header of a binary export
+struct ExportHeader {
+    std::string name;
+    KeyspaceSpec spec;
+    uint64_t count = 0;
+    uint64_t version = 0;
+};
+
+// Reads a binary export, compressed or not, as a stream: the header up
+// front, then rows a chunk at a time, so the whole file is never in memory
+class ExportReader {
+private:
+    // gzread reads plain files unchanged, so one reader covers both cases
+    class GzipBuffer : public std::streambuf {
+    private:
+        gzFile in;
+        std::vector<char> buffer;
+
+    protected:
+        int_type underflow() override {
+            // A decompression error ends the stream early, which reads as a truncated file
+            int read = gzread(in, buffer.data(), static_cast<unsigned>(buffer.size()));
+            if (read <= 0) {
+                return traits_type::eof();
+            }
+            setg(buffer.data(), buffer.data(), buffer.data() + read);
+            return traits_type::to_int_type(buffer[0]);
+        }
+
+    public:
+        GzipBuffer(gzFile in, size_t size) : in(in), buffer(size) {}
+    };
+
+    std::string path;
+    gzFile file;
+    GzipBuffer buffer;
+    std::istream in;
+    ExportHeader header;
+    uint64_t rows_read = 0;
+
+public:
+    explicit ExportReader(const std::string& path, size_t chunk_bytes = 1 << 20)
+        : path(path), file(gzopen(path.c_str(), "rb")), buffer(file, std::max<size_t>(chunk_bytes, 4096)),
+          in(&buffer) {
+        if (!file) {
+            throw std::runtime_error("Failed to open export file: " + path);
+        }
+        try {
+            if (readPod<uint32_t>(in) != kExportMagic) {
+                throw std::runtime_error("Not a keyspace export: " + path);
+            }
+            if (readPod<uint32_t>(in) != kExportFormatVersion) {
+                throw std::runtime_error("Unsupported export version: " + path);
+            }
+            header.name = readString(in);
+            header.spec = readSpec(in);
+            header.count = readPod<uint64_t>(in);
+            header.version = readPod<uint64_t>(in);
+        } catch (...) {
+            gzclose(file);
+            throw;
+        }
+    }
+
+    ~ExportReader() {
+        gzclose(file);
+    }
+
+    ExportReader(const ExportReader&) = delete;
+    ExportReader& operator=(const ExportReader&) = delete;
+
+    const ExportHeader& getHeader() const { return header; }
+
+    // Read up to `max_rows` of the remaining rows into `out`; 0 once all rows are read
+    size_t readRows(double* out, size_t max_rows) {
+        size_t rows = static_cast<size_t>(std::min<uint64_t>(max_rows, header.count - rows_read));
+        size_t bytes = rows * header.spec.dimension * sizeof(double);
+        if (rows > 0 && !in.read(reinterpret_cast<char*>(out), static_cast<std::streamsize>(bytes))) {
+            throw std::runtime_error("Corrupt export file: " + path);
+        }
+        rows_read += rows;
+        return rows;
+    }
+
+    // Check that every row was read and nothing follows them
+    void finish() {
+        if (rows_read != header.count || in.peek() != std::char_traits<char>::eof()) {
+            throw std::runtime_error("Corrupt export file: " + path);
+        }
+    }
+};
+
+#endif // KEYSPACE_EXPORT_HPP
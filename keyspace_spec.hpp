@@ -0,0 +1,103 @@
+#ifndef KEYSPACE_SPEC_HPP
+#define KEYSPACE_SPEC_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+
+// Element type of stored vectors
+enum class ElementType : uint8_t {
+    Float64 = 0,
+};
+
+// Distance used by nearest-neighbor and threshold searches
+enum class DistanceMetric : uint8_t {
+    Euclidean = 0,
+    Cosine = 1,
+    Manhattan = 2,
+    InnerProduct = 3,  // raw dot product, largest first (maximum inner product search)
+};
+
+// Search structure built over a keyspace
+enum class IndexType : uint8_t {
+    Flat = 0,   // exhaustive scan
+    Graph = 1,  // proximity graph for approximate nearest-neighbor search
+};
+
+// Largest GraphIndexParams::degree; rows keep up to twice as many links
+constexpr uint32_t kGraphDegreeLimit = 128;
+
+// Tuning of IndexType::Graph keyspaces; other index types ignore it
+struct GraphIndexParams {
+    uint32_t degree = 16;        // links made when a row is inserted; rows keep up to twice as many
+    uint32_t build_width = 100;  // beam width while inserting rows
+    uint32_t search_width = 64;  // beam width for queries; wider trades speed for recall
+
+    bool operator==(const GraphIndexParams& other) const {
+        return degree == other.degree && build_width == other.build_width && search_width == other.search_width;
+    }
+};
+
+// Where a keyspace lives when it belongs to a durable VectorStore
+enum class StorageTier : uint8_t {
+    Durable = 0,  // logged to the WAL and included in checkpoints
+    Memory = 1,   // never persisted; lost on restart
+};
+
+// Declares everything about a keyspace that is fixed at creation. The
+// keyspace picks its storage and distance kernels from the spec once, so
+// searches never re-check configuration per row.
+struct KeyspaceSpec {
+    size_t dimension = 0;
+    ElementType element_type = ElementType::Float64;
+    DistanceMetric metric = DistanceMetric::Euclidean;
+    bool normalize = false;  // scale stored and query vectors to unit length
+    IndexType index = IndexType::Flat;
+    GraphIndexParams graph;
+    StorageTier storage = StorageTier::Durable;
+
+    KeyspaceSpec() = default;
+    explicit KeyspaceSpec(size_t dim) : dimension(dim) {}
+
+    void validate() const {
+        if (element_type != ElementType::Float64) {
+            throw std::invalid_argument("Unsupported element type");
+        }
+        if (metric != DistanceMetric::Euclidean && metric != DistanceMetric::Cosine &&
+            metric != DistanceMetric::Manhattan && metric != DistanceMetric::InnerProduct) {
+            throw std::invalid_argument("Unsupported distance metric");
+        }
+        if (index != IndexType::Flat && index != IndexType::Graph) {
+            throw std::invalid_argument("Unsupported index type");
+        }
+        if (graph.degree == 0 || graph.degree > kGraphDegreeLimit) {
+            throw std::invalid_argument("Graph degree must be between 1 and " + std::to_string(kGraphDegreeLimit));
+        }
+        if (graph.build_width < graph.degree || graph.search_width == 0) {
+            throw std::invalid_argument("Graph build width must be at least the degree, and search width positive");
+        }
+        if (storage != StorageTier::Durable && storage != StorageTier::Memory) {
+            throw std::invalid_argument("Unsupported storage tier");
+        }
+    }
+
+    bool operator==(const KeyspaceSpec& other) const {
+        return dimension == other.dimension && element_type == other.element_type &&
+               metric == other.metric && normalize == other.normalize &&
+               index == other.index && graph == other.graph && storage == other.storage;
+    }
+    bool operator!=(const KeyspaceSpec& other) const { return !(*this == other); }
+};
+
+inline const char* metricName(DistanceMetric metric) {
+    switch (metric) {
+        case DistanceMetric::Euclidean: return "euclidean";
+        case DistanceMetric::Cosine: return "cosine";
+        case DistanceMetric::Manhattan: return "manhattan";
+        case DistanceMetric::InnerProduct: return "inner_product";
+    }
+    return "unknown";
+}
+
+#endif // KEYSPACE_SPEC_HPP
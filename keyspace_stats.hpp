@@ -0,0 +1,136 @@
+#ifndef KEYSPACE_STATS_HPP
+#define KEYSPACE_STATS_HPP
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <thread>
+
+// Operation counters for a keyspace, cheap enough to bump on every search.
+//
+// A single shared atomic would bounce its cache line between every core that
+// searches the keyspace. Instead the counters are striped: each stripe holds
+// one copy of every counter on its own cache line, each thread counts into
+// the stripe picked by its thread number, and reads sum all stripes. With at
+// least as many stripes as cores a stripe's line stays in one core's cache,
+// so an increment is an uncontended relaxed add.
+//
+// Most keyspaces of a store with many tenants are idle or used by one thread,
+// so stripes cost memory only once they are needed. Each keyspace embeds one
+// stripe, taken by the first thread that counts. The array of per-thread
+// stripes, one per hardware thread, is allocated when a second thread counts.
+
+enum class KeyspaceCounter {
+    NearestSearches,
+    ThresholdSearches,
+    ThresholdResults,  // rows returned by threshold searches
+    RowsScanned,       // rows evaluated by scans, including those a graph does not cover yet
+    Inserts,
+    Updates,
+    Removes,
+    WriteBatches,
+};
+constexpr size_t kKeyspaceCounterCount = 8;
+
+constexpr size_t kStatsMaxStripes = 64;
+constexpr size_t kStatsCacheLine = 64;
+
+// Totals across all threads at the time of reading
+struct KeyspaceStats {
+    uint64_t nearest_searches = 0;
+    uint64_t threshold_searches = 0;
+    uint64_t threshold_results = 0;
+    uint64_t rows_scanned = 0;
+    uint64_t inserts = 0;
+    uint64_t updates = 0;
+    uint64_t removes = 0;
+    uint64_t write_batches = 0;
+};
+
+// Number of the calling thread, shared by every StripedCounters instance
+inline size_t statsThread() {
+    static std::atomic<size_t> next_thread{0};
+    thread_local size_t thread = next_thread.fetch_add(1, std::memory_order_relaxed);
+    return thread;
+}
+
+// Stripes in a per-thread array: one per hardware thread, at most kStatsMaxStripes
+inline size_t statsStripeCount() {
+    static const size_t count = std::clamp<size_t>(std::thread::hardware_concurrency(), 1, kStatsMaxStripes);
+    return count;
+}
+
+class StripedCounters {
+private:
+    struct alignas(kStatsCacheLine) Stripe {
+        std::array<std::atomic<uint64_t>, kKeyspaceCounterCount> values{};
+    };
+    static_assert(sizeof(Stripe) == kStatsCacheLine, "one stripe per cache line");
+
+    static constexpr size_t kNoOwner = std::numeric_limits<size_t>::max();
+
+    Stripe first;                           // used by the thread in `owner`
+    std::atomic<size_t> owner{kNoOwner};
+    std::atomic<Stripe*> stripes{nullptr};  // statsStripeCount() stripes, for every other thread
+
+    Stripe& threadStripe(size_t thread) {
+        Stripe* array = stripes.load(std::memory_order_acquire);
+        if (!array) {
+            Stripe* fresh = new Stripe[statsStripeCount()];
+            if (stripes.compare_exchange_strong(array, fresh, std::memory_order_acq_rel)) {
+                array = fresh;
+            } else {
+                delete[] fresh;  // another thread installed its array first
+            }
+        }
+        return array[thread % statsStripeCount()];
+    }
+
+public:
+    StripedCounters() = default;
+    StripedCounters(const StripedCounters&) = delete;
+    StripedCounters& operator=(const StripedCounters&) = delete;
+    ~StripedCounters() { delete[] stripes.load(std::memory_order_relaxed); }
+
+    void add(KeyspaceCounter counter, uint64_t amount = 1) {
+        size_t thread = statsThread();
+        size_t current = owner.load(std::memory_order_relaxed);
+        if (current == kNoOwner &&
+            owner.compare_exchange_strong(current, thread, std::memory_order_relaxed)) {
+            current = thread;
+        }
+        Stripe& stripe = current == thread ? first : threadStripe(thread);
+        // Only this thread (or the few sharing its stripe) writes here, so a
+        // relaxed add never waits on another core's line
+        stripe.values[static_cast<size_t>(counter)].fetch_add(amount, std::memory_order_relaxed);
+    }
+
+    uint64_t get(KeyspaceCounter counter) const {
+        size_t index = static_cast<size_t>(counter);
+        uint64_t total = first.values[index].load(std::memory_order_relaxed);
+        if (const Stripe* array = stripes.load(std::memory_order_acquire)) {
+            for (size_t s = 0; s < statsStripeCount(); ++s) {
+                total += array[s].values[index].load(std::memory_order_relaxed);
+            }
+        }
+        return total;
+    }
+
+    KeyspaceStats snapshot() const {
+        KeyspaceStats stats;
+        stats.nearest_searches = get(KeyspaceCounter::NearestSearches);
+        stats.threshold_searches = get(KeyspaceCounter::ThresholdSearches);
+        stats.threshold_results = get(KeyspaceCounter::ThresholdResults);
+        stats.rows_scanned = get(KeyspaceCounter::RowsScanned);
+        stats.inserts = get(KeyspaceCounter::Inserts);
+        stats.updates = get(KeyspaceCounter::Updates);
+        stats.removes = get(KeyspaceCounter::Removes);
+        stats.write_batches = get(KeyspaceCounter::WriteBatches);
+        return stats;
+    }
+};
+
+#endif // KEYSPACE_STATS_HPP
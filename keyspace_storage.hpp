@@ -0,0 +1,287 @@
+#ifndef KEYSPACE_STORAGE_HPP
+#define KEYSPACE_STORAGE_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+#include <unordered_set>
+#include <vector>
+
+// Copy-on-write row storage for a Keyspace.
+//
+// Vectors live in fixed-capacity pages of contiguous rows. A KeyspaceData is an
+// immutable version of a keyspace: a page table plus a row count. Versions and
+// pages are shared by reference counting between a keyspace, its clones and
+// any reader still holding an older version. Writers never modify rows that a
+// published version can see; they copy the affected page instead. The only
+// in-place change is appending after the last row of the tail page, which is
+// claimed atomically so two keyspaces sharing a tail page cannot both extend it.
+//
+// The page table itself is split into fixed-size chunks that are shared the
+// same way, so adding a page copies only the chunk pointers and the tail chunk.
+
+constexpr size_t kPageRows = 256;
+constexpr size_t kTableChunkPages = 64;
+
+class VectorPage {
+private:
+    size_t dimension;
+    std::unique_ptr<double[]> values;
+    std::atomic<size_t> filled{0};  // rows written so far, across every owner
+
+public:
+    explicit VectorPage(size_t dim) : dimension(dim), values(new double[kPageRows * std::max<size_t>(dim, 1)]) {}
+
+    // New page holding `rows` rows copied from `source`, optionally without row `skip`
+    static std::shared_ptr<VectorPage> copyOf(const VectorPage& source, size_t rows, size_t skip = SIZE_MAX) {
+        auto page = std::make_shared<VectorPage>(source.dimension);
+        size_t out = 0;
+        for (size_t r = 0; r < rows; ++r) {
+            if (r != skip) {
+                std::memcpy(page->row(out++), source.row(r), source.dimension * sizeof(double));
+            }
+        }
+        page->filled = out;
+        return page;
+    }
+
+    const double* row(size_t r) const { return values.get() + r * dimension; }
+    double* row(size_t r) { return values.get() + r * dimension; }
+
+    // Remove row `r` of the first `rows` rows. Only valid on a page that no
+    // published version references yet.
+    void eraseRow(size_t r, size_t rows) {
+        std::memmove(row(r), row(r + 1), (rows - r - 1) * dimension * sizeof(double));
+        filled = rows - 1;
+    }
+
+    // Claim the row after the first `rows_seen` rows for appending. Fails when
+    // another keyspace sharing this page already appended there.
+    bool claimAppend(size_t rows_seen) {
+        return rows_seen < kPageRows && filled.compare_exchange_strong(rows_seen, rows_seen + 1);
+    }
+};
+
+// Pages of a version in row order, with the index of each page's first row.
+// Copies share chunks; a chunk is copied before a table modifies it unless
+// the table is its only owner. Tables are only modified before they are
+// published.
+class PageTable {
+private:
+    struct Chunk {
+        std::vector<std::shared_ptr<VectorPage>> pages;
+        std::vector<size_t> first_row;
+    };
+
+    std::vector<std::shared_ptr<Chunk>> chunks;  // all full except the last
+    size_t page_count = 0;
+
+    Chunk& mutableChunk(size_t chunk) {
+        if (chunks[chunk].use_count() > 1) {
+            chunks[chunk] = std::make_shared<Chunk>(*chunks[chunk]);
+        }
+        return *chunks[chunk];
+    }
+
+public:
+    size_t pageCount() const { return page_count; }
+
+    const std::shared_ptr<VectorPage>& page(size_t p) const {
+        return chunks[p / kTableChunkPages]->pages[p % kTableChunkPages];
+    }
+
+    size_t firstRow(size_t p) const {
+        return chunks[p / kTableChunkPages]->first_row[p % kTableChunkPages];
+    }
+
+    // Page holding row `index`
+    size_t pageOf(size_t index) const {
+        auto chunk = std::upper_bound(chunks.begin(), chunks.end(), index,
+            [](size_t row, const std::shared_ptr<Chunk>& c) { return row < c->first_row.front(); }) - 1;
+        const std::vector<size_t>& first_row = (*chunk)->first_row;
+        auto it = std::upper_bound(first_row.begin(), first_row.end(), index);
+        return static_cast<size_t>(chunk - chunks.begin()) * kTableChunkPages +
+               static_cast<size_t>(it - first_row.begin()) - 1;
+    }
+
+    void setPage(size_t p, std::shared_ptr<VectorPage> page) {
+        mutableChunk(p / kTableChunkPages).pages[p % kTableChunkPages] = std::move(page);
+    }
+
+    void pushPage(std::shared_ptr<VectorPage> page, size_t first_row) {
+        if (page_count % kTableChunkPages == 0) {
+            chunks.push_back(std::make_shared<Chunk>());
+        }
+        Chunk& tail = mutableChunk(chunks.size() - 1);
+        tail.pages.push_back(std::move(page));
+        tail.first_row.push_back(first_row);
+        ++page_count;
+    }
+
+    // Remove page `p`; later pages move down by one, keeping their first rows
+    void erasePage(size_t p) {
+        for (size_t q = p; q + 1 < page_count; ++q) {
+            Chunk& chunk = mutableChunk(q / kTableChunkPages);
+            chunk.pages[q % kTableChunkPages] = page(q + 1);
+            chunk.first_row[q % kTableChunkPages] = firstRow(q + 1);
+        }
+        --page_count;
+        if (page_count % kTableChunkPages == 0) {
+            chunks.pop_back();
+        } else {
+            Chunk& tail = mutableChunk(chunks.size() - 1);
+            tail.pages.pop_back();
+            tail.first_row.pop_back();
+        }
+    }
+
+    // Shift the first row of pages [p, pageCount()) down by one
+    void shiftDown(size_t p) {
+        for (; p < page_count; ++p) {
+            --mutableChunk(p / kTableChunkPages).first_row[p % kTableChunkPages];
+        }
+    }
+};
+
+struct KeyspaceData {
+    std::shared_ptr<const PageTable> table = std::make_shared<PageTable>();
+    size_t count = 0;
+    uint64_t version = 0;
+    uint64_t rewritten_version = 0;  // last version that removed or updated rows; later ones only appended
+
+    size_t pageCount() const { return table->pageCount(); }
+
+    size_t firstRow(size_t page) const { return table->firstRow(page); }
+
+    size_t rowsInPage(size_t page) const {
+        size_t end = page + 1 < table->pageCount() ? table->firstRow(page + 1) : count;
+        return end - table->firstRow(page);
+    }
+
+    const double* pageRows(size_t page) const { return table->page(page)->row(0); }
+
+    // Page holding row `index` and the row's offset inside it
+    std::pair<size_t, size_t> locate(size_t index) const {
+        size_t page = table->pageOf(index);
+        return {page, index - table->firstRow(page)};
+    }
+
+    const double* row(size_t index) const {
+        auto [page, offset] = locate(index);
+        return table->page(page)->row(offset);
+    }
+};
+
+// Builds the next version of a KeyspaceData. The page table is copied only
+// when a page has to be added, replaced or removed, so plain appends into the
+// tail page cost O(1) and a new page costs one chunk copy.
+class KeyspaceDataBuilder {
+private:
+    size_t dimension;
+    std::shared_ptr<const PageTable> table;
+    std::shared_ptr<PageTable> owned;  // set once `table` has been copied
+    std::unordered_set<const VectorPage*> fresh_pages;  // copied by this builder, not yet published
+    size_t count;
+    uint64_t version;
+    uint64_t rewritten_version;
+    bool rewrites = false;  // whether a row was removed or updated
+
+    PageTable& mutableTable() {
+        if (!owned) {
+            owned = std::make_shared<PageTable>(*table);
+            table = owned;
+        }
+        return *owned;
+    }
+
+    size_t tailRows() const {
+        return table->pageCount() == 0 ? 0 : count - table->firstRow(table->pageCount() - 1);
+    }
+
+    KeyspaceData view() const {
+        return KeyspaceData{table, count, version, rewritten_version};
+    }
+
+    // Page `page` in a form this builder may modify in place
+    VectorPage& privatePage(size_t page, size_t rows) {
+        if (fresh_pages.count(table->page(page).get()) == 0) {
+            auto copy = VectorPage::copyOf(*table->page(page), rows);
+            fresh_pages.insert(copy.get());
+            mutableTable().setPage(page, std::move(copy));
+        }
+        return *table->page(page);
+    }
+
+public:
+    KeyspaceDataBuilder(const KeyspaceData& base, size_t dim)
+        : dimension(dim), table(base.table), count(base.count), version(base.version),
+          rewritten_version(base.rewritten_version) {}
+
+    size_t size() const { return count; }
+
+    void append(const double* values) {
+        size_t tail_rows = tailRows();
+        size_t pages = table->pageCount();
+        std::shared_ptr<VectorPage> page;
+        if (pages > 0 && table->page(pages - 1)->claimAppend(tail_rows)) {
+            page = table->page(pages - 1);
+        } else if (pages > 0 && tail_rows < kPageRows) {
+            // The shared tail page was extended by another owner; take a private copy
+            page = VectorPage::copyOf(*table->page(pages - 1), tail_rows);
+            page->claimAppend(tail_rows);
+            mutableTable().setPage(pages - 1, page);
+            fresh_pages.insert(page.get());
+        } else {
+            page = std::make_shared<VectorPage>(dimension);
+            page->claimAppend(0);
+            fresh_pages.insert(page.get());
+            tail_rows = 0;
+            mutableTable().pushPage(page, count);
+        }
+        std::memcpy(page->row(tail_rows), values, dimension * sizeof(double));
+        ++count;
+    }
+
+    void remove(size_t index) {
+        KeyspaceData current = view();
+        auto [page, offset] = current.locate(index);
+        size_t rows = current.rowsInPage(page);
+        rewrites = true;
+        PageTable& t = mutableTable();
+        if (rows == 1) {
+            t.erasePage(page);
+        } else if (fresh_pages.count(t.page(page).get()) > 0) {
+            t.page(page)->eraseRow(offset, rows);
+            ++page;
+        } else {
+            auto copy = VectorPage::copyOf(*t.page(page), rows, offset);
+            fresh_pages.insert(copy.get());
+            t.setPage(page, std::move(copy));
+            ++page;
+        }
+        t.shiftDown(page);
+        --count;
+    }
+
+    void update(size_t index, const double* values) {
+        KeyspaceData current = view();
+        auto [page, offset] = current.locate(index);
+        VectorPage& target = privatePage(page, current.rowsInPage(page));
+        rewrites = true;
+        std::memcpy(target.row(offset), values, dimension * sizeof(double));
+    }
+
+    std::shared_ptr<const KeyspaceData> build() {
+        auto data = std::make_shared<KeyspaceData>();
+        data->table = table;
+        data->count = count;
+        data->version = version + 1;
+        data->rewritten_version = rewrites ? data->version : rewritten_version;
+        return data;
+    }
+};
+
+#endif // KEYSPACE_STORAGE_HPP
@@ -0,0 +1,343 @@
+#include "vector_store.hpp"
+#include "dataset_generator.hpp"
+#include "bench_report.hpp"
+#include <spdlog/spdlog.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Concurrent mixed read/write load against one VectorStore.
+//
+// Each worker thread issues searches, inserts and deletes against randomly
+// chosen keyspaces. With --rate the load is open loop: every worker draws
+// Poisson arrivals at its share of the rate and an operation's latency is
+// measured from when it was scheduled, so queueing behind slow operations
+// shows up in the percentiles. Without --rate workers run closed loop, each
+// issuing its next operation as soon as the previous one finishes.
+//
+// Usage: load_generator [--threads N] [--duration SECONDS] [--rate OPS_PER_SEC]
+//                       [--read-ratio R] [--delete-ratio R] [--dimension D]
+//                       [--keyspaces K] [--initial-vectors N] [--interval SECONDS]
+//                       [--threshold T] [--seed S] [--trace PATH] [--json PATH]
+//                       [--perf-sample N] [--slow-query-us US --slow-query-dump PATH]
+//                       [--index flat|graph]
+//
+// With --trace the operations are recorded for replay with trace_replay.
+// With --json the totals are also written as a benchmark report. With
+// --perf-sample N one in every N searches and writes per thread is measured
+// with hardware performance counters. With --slow-query-us searches slower
+// than US microseconds are logged and dumped to --slow-query-dump at the end.
+// With --index graph nearest searches use a graph index, kept up to date in
+// the background: inserts extend it, but every remove makes it rebuild and
+// searches scan until it has, so pair it with a high --read-ratio.
+
+using namespace std::chrono;
+
+struct LoadOptions {
+    size_t threads = 4;
+    double duration_seconds = 10.0;
+    double rate = 0.0;             // total operations per second, 0 = closed loop
+    double read_ratio = 0.9;       // fraction of operations that are searches
+    double delete_ratio = 0.5;     // fraction of writes that are deletes
+    size_t dimension = 128;
+    size_t keyspaces = 4;
+    size_t initial_vectors = 10000;
+    double interval_seconds = 1.0;
+    double threshold = 0.5;        // similarity threshold for threshold searches
+    uint64_t seed = 42;
+    std::string trace_path;        // record a workload trace when set
+    std::string json_path;         // write a benchmark report when set
+    size_t perf_sample = 0;        // sample hardware counters every N calls, 0 = off
+    double slow_query_us = 0.0;    // log searches slower than this, 0 = off
+    std::string slow_query_dump = "slow_queries.bin";
+    IndexType index = IndexType::Flat;
+};
+
+enum OpKind { kSearch = 0, kInsert = 1, kDelete = 2, kOpKinds = 3 };
+
+const char* opName(int kind) {
+    static const char* names[] = {"search", "insert", "delete"};
+    return names[kind];
+}
+
+// Latency samples of one worker, drained by the reporter once per interval
+struct WorkerSamples {
+    std::mutex mtx;
+    std::vector<double> latencies_us[kOpKinds];
+    size_t errors = 0;
+};
+
+struct IntervalSummary {
+    size_t count = 0;
+    double p50 = 0, p90 = 0, p99 = 0, p999 = 0, max = 0;
+};
+
+IntervalSummary summarize(std::vector<double>& samples) {
+    IntervalSummary summary;
+    summary.count = samples.size();
+    if (samples.empty()) {
+        return summary;
+    }
+    std::sort(samples.begin(), samples.end());
+    auto at = [&](double q) {
+        return samples[std::min(samples.size() - 1, static_cast<size_t>(q * samples.size()))];
+    };
+    summary.p50 = at(0.50);
+    summary.p90 = at(0.90);
+    summary.p99 = at(0.99);
+    summary.p999 = at(0.999);
+    summary.max = samples.back();
+    return summary;
+}
+
+Vector randomVector(size_t dimension, std::mt19937_64& gen) {
+    std::uniform_real_distribution<double> dis(-1.0, 1.0);
+    Vector vec(dimension);
+    for (size_t i = 0; i < dimension; ++i) {
+        vec[i] = dis(gen);
+    }
+    return vec;
+}
+
+void worker(const LoadOptions& options, size_t id, const std::vector<std::shared_ptr<Keyspace>>& keyspaces,
+            WorkerSamples& samples, steady_clock::time_point deadline) {
+    std::mt19937_64 gen(options.seed * 7919 + id);
+    std::uniform_real_distribution<double> unit(0.0, 1.0);
+    std::uniform_int_distribution<size_t> pick_keyspace(0, keyspaces.size() - 1);
+    std::exponential_distribution<double> gap(options.rate > 0 ? options.rate / options.threads : 1.0);
+
+    std::vector<std::pair<size_t, double>> results;  // reused so searches do not allocate
+    steady_clock::time_point scheduled = steady_clock::now();
+    while (true) {
+        if (options.rate > 0) {
+            scheduled += duration_cast<steady_clock::duration>(duration<double>(gap(gen)));
+            if (scheduled >= deadline) {
+                break;
+            }
+            std::this_thread::sleep_until(scheduled);
+        } else {
+            scheduled = steady_clock::now();
+            if (scheduled >= deadline) {
+                break;
+            }
+        }
+
+        int kind = unit(gen) < options.read_ratio ? kSearch : (unit(gen) < options.delete_ratio ? kDelete : kInsert);
+        Keyspace& keyspace = *keyspaces[pick_keyspace(gen)];
+        Vector vec = randomVector(options.dimension, gen);
+        bool failed = false;
+        try {
+            if (kind == kSearch) {
+                keyspace.findNearestNeighbor(vec);
+                keyspace.findNeighborsAboveThreshold(vec, options.threshold, results);
+            } else if (kind == kInsert) {
+                keyspace.addVector(vec);
+            } else {
+                size_t size = keyspace.size();
+                if (size > 0) {
+                    keyspace.removeVector(gen() % size);
+                }
+            }
+        } catch (const std::exception&) {
+            // Another worker may have emptied the keyspace or removed the row first
+            failed = true;
+        }
+        double latency_us = duration<double, std::micro>(steady_clock::now() - scheduled).count();
+
+        std::lock_guard<std::mutex> lock(samples.mtx);
+        if (failed) {
+            ++samples.errors;
+        } else {
+            samples.latencies_us[kind].push_back(latency_us);
+        }
+    }
+}
+
+// Move every worker's samples for the interval into `totals`, logging the interval
+void reportInterval(std::vector<WorkerSamples>& workers, std::vector<double> (&totals)[kOpKinds],
+                    size_t& total_errors, double elapsed_seconds, double interval_seconds) {
+    std::vector<double> interval[kOpKinds];
+    size_t errors = 0;
+    for (auto& samples : workers) {
+        std::lock_guard<std::mutex> lock(samples.mtx);
+        for (int kind = 0; kind < kOpKinds; ++kind) {
+            interval[kind].insert(interval[kind].end(), samples.latencies_us[kind].begin(),
+                                  samples.latencies_us[kind].end());
+            samples.latencies_us[kind].clear();
+        }
+        errors += samples.errors;
+        samples.errors = 0;
+    }
+    total_errors += errors;
+    for (int kind = 0; kind < kOpKinds; ++kind) {
+        totals[kind].insert(totals[kind].end(), interval[kind].begin(), interval[kind].end());
+        IntervalSummary s = summarize(interval[kind]);
+        spdlog::info("[{:6.1f}s] {:<6} {:>9.0f} ops/s  p50 {:>8.1f}us  p99 {:>9.1f}us  max {:>9.1f}us",
+                     elapsed_seconds, opName(kind), s.count / interval_seconds, s.p50, s.p99, s.max);
+    }
+    if (errors > 0) {
+        spdlog::info("[{:6.1f}s] {} operations failed", elapsed_seconds, errors);
+    }
+}
+
+LoadOptions parseOptions(int argc, char** argv) {
+    LoadOptions options;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (i + 1 >= argc) {
+            throw std::invalid_argument("Missing value for " + arg);
+        }
+        const char* value = argv[++i];
+        if (arg == "--threads") options.threads = std::stoul(value);
+        else if (arg == "--duration") options.duration_seconds = std::stod(value);
+        else if (arg == "--rate") options.rate = std::stod(value);
+        else if (arg == "--read-ratio") options.read_ratio = std::stod(value);
+        else if (arg == "--delete-ratio") options.delete_ratio = std::stod(value);
+        else if (arg == "--dimension") options.dimension = std::stoul(value);
+        else if (arg == "--keyspaces") options.keyspaces = std::stoul(value);
+        else if (arg == "--initial-vectors") options.initial_vectors = std::stoul(value);
+        else if (arg == "--interval") options.interval_seconds = std::stod(value);
+        else if (arg == "--threshold") options.threshold = std::stod(value);
+        else if (arg == "--seed") options.seed = std::stoull(value);
+        else if (arg == "--trace") options.trace_path = value;
+        else if (arg == "--json") options.json_path = value;
+        else if (arg == "--perf-sample") options.perf_sample = std::stoul(value);
+        else if (arg == "--slow-query-us") options.slow_query_us = std::stod(value);
+        else if (arg == "--slow-query-dump") options.slow_query_dump = value;
+        else if (arg == "--index" && std::strcmp(value, "flat") == 0) options.index = IndexType::Flat;
+        else if (arg == "--index" && std::strcmp(value, "graph") == 0) options.index = IndexType::Graph;
+        else throw std::invalid_argument("Unknown option: " + arg);
+    }
+    if (options.threads == 0 || options.keyspaces == 0 || options.dimension == 0 || options.interval_seconds <= 0) {
+        throw std::invalid_argument("threads, keyspaces, dimension and interval must be positive");
+    }
+    return options;
+}
+
+int main(int argc, char** argv) {
+    LoadOptions options;
+    try {
+        options = parseOptions(argc, argv);
+    } catch (const std::exception& e) {
+        spdlog::error("{}", e.what());
+        return 1;
+    }
+    spdlog::set_level(spdlog::level::info);
+    spdlog::info("Load: {} threads, {}s, {}, {:.0f}% reads, {} keyspaces of {} x {}",
+                 options.threads, options.duration_seconds,
+                 options.rate > 0 ? fmt::format("open loop at {} ops/s", options.rate) : "closed loop",
+                 options.read_ratio * 100, options.keyspaces, options.initial_vectors, options.dimension);
+
+    VectorStore store("load_generator_store");
+    // Trace from the start so the initial rows are part of the replay
+    if (!options.trace_path.empty()) {
+        store.startTrace(options.trace_path);
+    }
+    std::vector<std::shared_ptr<Keyspace>> keyspaces;
+    for (size_t k = 0; k < options.keyspaces; ++k) {
+        KeyspaceSpec keyspace_spec(options.dimension);
+        keyspace_spec.index = options.index;
+        auto keyspace = store.createKeyspace(keyspace_spec, "keyspace_" + std::to_string(k));
+        DatasetSpec spec;
+        spec.count = options.initial_vectors;
+        spec.dimension = options.dimension;
+        spec.seed = options.seed + k;
+        std::vector<double> values = generateDataset(spec);
+        WriteBatch batch;
+        Vector vec(options.dimension);
+        for (size_t i = 0; i < options.initial_vectors; ++i) {
+            std::copy(values.begin() + i * options.dimension, values.begin() + (i + 1) * options.dimension,
+                      vec.getData());
+            batch.insert(vec);
+        }
+        keyspace->applyBatch(batch);
+        if (options.index == IndexType::Graph) {
+            keyspace->buildGraphIndex();
+        }
+        keyspaces.push_back(keyspace);
+    }
+
+    if (options.perf_sample > 0) {
+        store.enablePerfCounters(options.perf_sample);
+    }
+    if (options.slow_query_us > 0) {
+        store.enableSlowQueryLog(options.slow_query_us);
+    }
+
+    std::vector<WorkerSamples> samples(options.threads);
+    auto start = steady_clock::now();
+    auto deadline = start + duration_cast<steady_clock::duration>(duration<double>(options.duration_seconds));
+    std::vector<std::thread> threads;
+    for (size_t t = 0; t < options.threads; ++t) {
+        threads.emplace_back(worker, std::cref(options), t, std::cref(keyspaces), std::ref(samples[t]), deadline);
+    }
+
+    std::vector<double> totals[kOpKinds];
+    size_t total_errors = 0;
+    auto interval = duration_cast<steady_clock::duration>(duration<double>(options.interval_seconds));
+    for (auto next = start + interval; next < deadline; next += interval) {
+        std::this_thread::sleep_until(next);
+        reportInterval(samples, totals, total_errors, duration<double>(next - start).count(),
+                       options.interval_seconds);
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    double elapsed = duration<double>(steady_clock::now() - start).count();
+    double tail = std::fmod(options.duration_seconds, options.interval_seconds);
+    reportInterval(samples, totals, total_errors, elapsed, tail > 0 ? tail : options.interval_seconds);
+
+    BenchReport report("load_generator");
+    report.setDataset("distribution", "uniform");
+    report.setDataset("count", options.initial_vectors * options.keyspaces);
+    report.setDataset("dimension", options.dimension);
+    report.setDataset("seed", options.seed);
+    report.setParameter("threads", options.threads);
+    report.setParameter("duration_seconds", options.duration_seconds);
+    report.setParameter("rate", options.rate);
+    report.setParameter("read_ratio", options.read_ratio);
+    report.setParameter("delete_ratio", options.delete_ratio);
+    report.setParameter("keyspaces", options.keyspaces);
+    report.setParameter("threshold", options.threshold);
+    report.setParameter("index", options.index == IndexType::Graph ? "graph" : "flat");
+    report.addSample("failed_operations", "ops", static_cast<double>(total_errors));
+
+    spdlog::info("=== Totals over {:.1f}s ===", elapsed);
+    for (int kind = 0; kind < kOpKinds; ++kind) {
+        report.addSamples(std::string(opName(kind)) + ".latency", "us", totals[kind]);
+        report.addSample(std::string(opName(kind)) + ".throughput", "ops/s", totals[kind].size() / elapsed, false);
+        IntervalSummary s = summarize(totals[kind]);
+        spdlog::info("{:<6} {:>9} ops {:>9.0f} ops/s  p50 {:.1f}us  p90 {:.1f}us  p99 {:.1f}us  p99.9 {:.1f}us  max {:.1f}us",
+                     opName(kind), s.count, s.count / elapsed, s.p50, s.p90, s.p99, s.p999, s.max);
+    }
+    spdlog::info("failed operations: {}", total_errors);
+    for (const auto& keyspace : keyspaces) {
+        KeyspaceStats stats = keyspace->getStats();
+        spdlog::info("{}: {} nearest, {} threshold searches, {} rows scanned, {} inserts, {} removes",
+                     keyspace->getName(), stats.nearest_searches, stats.threshold_searches, stats.rows_scanned,
+                     stats.inserts, stats.removes);
+    }
+    for (const auto& summary : store.getPerfCounters()) {
+        spdlog::info("counters {}", formatPerfSummary(summary));
+    }
+    report.addPerfCounters("", store.getPerfCounters());
+    if (options.slow_query_us > 0) {
+        store.dumpSlowQueries(options.slow_query_dump);
+    }
+    if (!options.trace_path.empty()) {
+        store.stopTrace();
+    }
+    if (!options.json_path.empty()) {
+        report.writeToFile(options.json_path);
+        spdlog::info("Wrote benchmark report to {}", options.json_path);
+    }
+    return 0;
+}
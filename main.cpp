@@ -1,18 +1,22 @@
 #include "vector_store.hpp"
+#include "dataset_generator.hpp"
 #include <iostream>
-#include <random>
 
-// Helper function to create a random vector
-Vector createRandomVector(size_t dimension) {
-    Vector vec(dimension);
-    std::random_device rd;
-    std::mt19937 gen(rd());
-    std::uniform_real_distribution<> dis(-1.0, 1.0);
-    
-    for(size_t i = 0; i < dimension; ++i) {
-        vec[i] = dis(gen);
+// Helper function to create reproducible random vectors, uniform in [-1, 1)
+std::vector<Vector> createRandomVectors(size_t count, size_t dimension, uint64_t seed) {
+    DatasetSpec spec;
+    spec.count = count;
+    spec.dimension = dimension;
+    spec.seed = seed;
+    std::vector<double> values = generateDataset(spec);
+
+    std::vector<Vector> vectors;
+    for(size_t i = 0; i < count; ++i) {
+        Vector vec(dimension);
+        std::copy(values.begin() + i * dimension, values.begin() + (i + 1) * dimension, vec.getData());
+        vectors.push_back(vec);
     }
-    return vec;
+    return vectors;
 }
 
 int main() {
@@ -25,14 +29,11 @@ int main() {
         store.addKeyspace(keyspace);
         
         // Add some random vectors to the keyspace
-        std::vector<Vector> vectors;
-        for(int i = 0; i < 5; ++i) {
-            vectors.push_back(createRandomVector(3));
-        }
+        std::vector<Vector> vectors = createRandomVectors(5, 3, 1);
         keyspace->batchAddVectors(vectors);
         
         // Create a query vector
-        Vector query = createRandomVector(3);
+        Vector query = createRandomVectors(1, 3, 2)[0];
         
         // Find nearest neighbor
         size_t nearest_idx = keyspace->findNearestNeighbor(query);
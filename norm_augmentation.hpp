@@ -0,0 +1,61 @@
+#ifndef NORM_AUGMENTATION_HPP
+#define NORM_AUGMENTATION_HPP
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include "keyspace_storage.hpp"
+
+// Reduction of maximum inner product search to Euclidean nearest neighbor.
+//
+// Inner product is not a metric, so structures built on Euclidean distance
+// cannot answer it directly. Appending one coordinate fixes that: with M the
+// largest row norm, a stored row x becomes (x, sqrt(M^2 - |x|^2)) and a query
+// q becomes (q, 0). Every augmented row then has norm M, and
+//   |q' - x'|^2 = |q|^2 + M^2 - 2 q.x
+// so the Euclidean-nearest augmented row is the row with the largest inner
+// product. The graph index applies this on the fly to InnerProduct keyspaces;
+// augmentRow and augmentQuery produce the vectors for an external L2 index.
+
+struct NormAugmentation {
+    double max_squared_norm = 0.0;
+
+    static double squaredNorm(const double* values, size_t dim) {
+        double sum = 0.0;
+        for (size_t i = 0; i < dim; ++i) {
+            sum += values[i] * values[i];
+        }
+        return sum;
+    }
+
+    // Fitted to the largest row of `data`. Rows added later must not be longer.
+    static NormAugmentation fit(const KeyspaceData& data, size_t dim) {
+        NormAugmentation augmentation;
+        for (size_t page = 0; page < data.pageCount(); ++page) {
+            const double* row = data.pageRows(page);
+            for (size_t r = 0; r < data.rowsInPage(page); ++r, row += dim) {
+                augmentation.max_squared_norm = std::max(augmentation.max_squared_norm, squaredNorm(row, dim));
+            }
+        }
+        return augmentation;
+    }
+
+    // Coordinate appended to a stored row
+    double extraCoordinate(const double* row, size_t dim) const {
+        return std::sqrt(std::max(0.0, max_squared_norm - squaredNorm(row, dim)));
+    }
+
+    // `row` followed by its extra coordinate, into `out` (dim + 1 values)
+    void augmentRow(const double* row, size_t dim, double* out) const {
+        std::copy(row, row + dim, out);
+        out[dim] = extraCoordinate(row, dim);
+    }
+
+    // Queries get 0 as their extra coordinate
+    static void augmentQuery(const double* query, size_t dim, double* out) {
+        std::copy(query, query + dim, out);
+        out[dim] = 0.0;
+    }
+};
+
+#endif // NORM_AUGMENTATION_HPP
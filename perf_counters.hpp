@@ -0,0 +1,316 @@
+#ifndef PERF_COUNTERS_HPP
+#define PERF_COUNTERS_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+#if defined(__linux__)
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+// Hardware performance counters around searches and bulk builds.
+//
+// On Linux each thread opens one perf_event_open group (cycles, instructions,
+// last-level cache misses, dTLB read misses, branch misses) counting user
+// space only, which works at the default perf_event_paranoid level. A
+// PerfProfiler decides which calls to measure (every Nth one per thread) and
+// accumulates the counts per query class; the ratios tell whether a class is
+// compute-bound (high IPC), cache-bound (high LLC misses per instruction) or
+// TLB-bound. Counters the CPU or hypervisor does not expose read as
+// unavailable, and on other platforms the whole layer is a no-op.
+
+enum class PerfEvent {
+    Cycles,
+    Instructions,
+    LlcMisses,
+    DtlbMisses,
+    BranchMisses,
+};
+constexpr size_t kPerfEventCount = 5;
+
+inline const char* perfEventName(PerfEvent event) {
+    static const char* names[kPerfEventCount] = {"cycles", "instructions", "llc_misses", "dtlb_misses",
+                                                 "branch_misses"};
+    return names[static_cast<size_t>(event)];
+}
+
+enum class PerfQueryClass {
+    Nearest,    // findNearestNeighbor
+    Threshold,  // findNeighborsAboveThreshold
+    Build,      // bulk construction: write batches and graph index builds
+};
+constexpr size_t kPerfQueryClassCount = 3;
+
+inline const char* perfQueryClassName(PerfQueryClass query_class) {
+    static const char* names[kPerfQueryClassCount] = {"nearest", "threshold", "build"};
+    return names[static_cast<size_t>(query_class)];
+}
+
+struct PerfCounterValues {
+    uint64_t counts[kPerfEventCount] = {};
+    bool available[kPerfEventCount] = {};
+
+    uint64_t operator[](PerfEvent event) const { return counts[static_cast<size_t>(event)]; }
+};
+
+// The calling thread's counter group. Counters only count the thread that
+// opened them, so each thread needs its own; use threadPerfCounters().
+class PerfCounterGroup {
+private:
+#if defined(__linux__)
+    int leader = -1;
+    int fds[kPerfEventCount];
+    // Position of each event in a group read, -1 when it could not be opened
+    int slot[kPerfEventCount];
+    size_t opened = 0;
+
+    static int open(uint32_t type, uint64_t config, int group) {
+        perf_event_attr attr;
+        std::memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = type;
+        attr.config = config;
+        attr.disabled = group == -1 ? 1 : 0;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+        return static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, group, 0));
+    }
+#endif
+
+public:
+    PerfCounterGroup() {
+#if defined(__linux__)
+        const std::pair<uint32_t, uint64_t> events[kPerfEventCount] = {
+            {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+            {PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+            {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES},
+            {PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_DTLB | (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                                 (PERF_COUNT_HW_CACHE_RESULT_MISS << 16)},
+            {PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES},
+        };
+        for (size_t e = 0; e < kPerfEventCount; ++e) {
+            fds[e] = open(events[e].first, events[e].second, leader);
+            slot[e] = fds[e] >= 0 ? static_cast<int>(opened++) : -1;
+            if (e == 0 && fds[e] < 0) {
+                break;  // no cycle counter: counters are not available at all
+            }
+            if (e == 0) {
+                leader = fds[0];
+            }
+        }
+        if (leader < 0) {
+            opened = 0;
+            for (size_t e = 1; e < kPerfEventCount; ++e) {
+                fds[e] = -1;
+                slot[e] = -1;
+            }
+        }
+#endif
+    }
+
+    ~PerfCounterGroup() {
+#if defined(__linux__)
+        for (size_t e = 0; e < kPerfEventCount; ++e) {
+            if (leader >= 0 && fds[e] >= 0) {
+                close(fds[e]);
+            }
+        }
+#endif
+    }
+
+    PerfCounterGroup(const PerfCounterGroup&) = delete;
+    PerfCounterGroup& operator=(const PerfCounterGroup&) = delete;
+
+    bool isAvailable() const {
+#if defined(__linux__)
+        return leader >= 0;
+#else
+        return false;
+#endif
+    }
+
+    void start() {
+#if defined(__linux__)
+        if (leader >= 0) {
+            ioctl(leader, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+            ioctl(leader, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+        }
+#endif
+    }
+
+    // Stop counting and return the counts since start(), scaled up if the
+    // kernel had to multiplex the group with other counters
+    PerfCounterValues stop() {
+        PerfCounterValues values;
+#if defined(__linux__)
+        if (leader < 0) {
+            return values;
+        }
+        ioctl(leader, PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+        // nr, time_enabled, time_running, then one value per opened counter
+        uint64_t buffer[3 + kPerfEventCount];
+        if (read(leader, buffer, sizeof(buffer)) < static_cast<ssize_t>((3 + opened) * sizeof(uint64_t))) {
+            return values;
+        }
+        double scale = buffer[2] > 0 && buffer[2] < buffer[1] ? static_cast<double>(buffer[1]) / buffer[2] : 1.0;
+        for (size_t e = 0; e < kPerfEventCount; ++e) {
+            if (slot[e] >= 0) {
+                values.available[e] = true;
+                values.counts[e] = static_cast<uint64_t>(buffer[3 + slot[e]] * scale);
+            }
+        }
+#endif
+        return values;
+    }
+};
+
+inline PerfCounterGroup& threadPerfCounters() {
+    thread_local PerfCounterGroup group;
+    return group;
+}
+
+// Totals of one query class
+struct PerfClassSummary {
+    PerfQueryClass query_class = PerfQueryClass::Nearest;
+    uint64_t samples = 0;
+    uint64_t totals[kPerfEventCount] = {};
+    bool available[kPerfEventCount] = {};
+
+    double perSample(PerfEvent event) const {
+        return samples ? static_cast<double>(totals[static_cast<size_t>(event)]) / samples : 0.0;
+    }
+
+    double instructionsPerCycle() const {
+        uint64_t cycles = totals[static_cast<size_t>(PerfEvent::Cycles)];
+        return cycles ? static_cast<double>(totals[static_cast<size_t>(PerfEvent::Instructions)]) / cycles : 0.0;
+    }
+
+    // Events per thousand instructions (MPKI for the miss counters)
+    double perKiloInstruction(PerfEvent event) const {
+        uint64_t instructions = totals[static_cast<size_t>(PerfEvent::Instructions)];
+        return instructions ? 1000.0 * totals[static_cast<size_t>(event)] / instructions : 0.0;
+    }
+};
+
+// One-line description of a summary for logs
+inline std::string formatPerfSummary(const PerfClassSummary& summary) {
+    if (summary.samples == 0) {
+        return std::string(perfQueryClassName(summary.query_class)) + ": no samples";
+    }
+    char line[256];
+    std::snprintf(line, sizeof(line),
+                  "%s: %llu samples, %.0f cycles, %.0f instructions per call, IPC %.2f, "
+                  "MPKI llc %.2f dtlb %.2f branch %.2f",
+                  perfQueryClassName(summary.query_class), static_cast<unsigned long long>(summary.samples),
+                  summary.perSample(PerfEvent::Cycles), summary.perSample(PerfEvent::Instructions),
+                  summary.instructionsPerCycle(), summary.perKiloInstruction(PerfEvent::LlcMisses),
+                  summary.perKiloInstruction(PerfEvent::DtlbMisses),
+                  summary.perKiloInstruction(PerfEvent::BranchMisses));
+    return line;
+}
+
+// Samples counters around calls and accumulates them per query class.
+// Shared by every keyspace of a store while counters are enabled.
+class PerfProfiler {
+private:
+    struct ClassTotals {
+        std::atomic<uint64_t> samples{0};
+        std::atomic<uint64_t> totals[kPerfEventCount] = {};
+        std::atomic<bool> available[kPerfEventCount] = {};
+    };
+
+    size_t sample_every;
+    ClassTotals classes[kPerfQueryClassCount];
+
+public:
+    // Measure one call in every `sample_every` per thread; 1 measures all of them
+    explicit PerfProfiler(size_t sample_every = 1) : sample_every(sample_every > 0 ? sample_every : 1) {}
+
+    size_t getSampleEvery() const { return sample_every; }
+
+    bool shouldSample() const {
+        thread_local size_t calls = 0;
+        return ++calls % sample_every == 0;
+    }
+
+    void record(PerfQueryClass query_class, const PerfCounterValues& values) {
+        ClassTotals& totals = classes[static_cast<size_t>(query_class)];
+        totals.samples.fetch_add(1, std::memory_order_relaxed);
+        for (size_t e = 0; e < kPerfEventCount; ++e) {
+            if (values.available[e]) {
+                totals.totals[e].fetch_add(values.counts[e], std::memory_order_relaxed);
+                totals.available[e].store(true, std::memory_order_relaxed);
+            }
+        }
+    }
+
+    PerfClassSummary summary(PerfQueryClass query_class) const {
+        const ClassTotals& totals = classes[static_cast<size_t>(query_class)];
+        PerfClassSummary summary;
+        summary.query_class = query_class;
+        summary.samples = totals.samples.load(std::memory_order_relaxed);
+        for (size_t e = 0; e < kPerfEventCount; ++e) {
+            summary.totals[e] = totals.totals[e].load(std::memory_order_relaxed);
+            summary.available[e] = totals.available[e].load(std::memory_order_relaxed);
+        }
+        return summary;
+    }
+
+    std::vector<PerfClassSummary> summaries() const {
+        std::vector<PerfClassSummary> out;
+        for (size_t c = 0; c < kPerfQueryClassCount; ++c) {
+            out.push_back(summary(static_cast<PerfQueryClass>(c)));
+        }
+        return out;
+    }
+};
+
+// Counts the enclosing block into `profiler` when the call is sampled. A
+// null profiler, a call that is not sampled, a thread without counters and
+// a scope nested in another measured scope all cost a branch or two.
+class PerfScope {
+private:
+    PerfProfiler* profiler = nullptr;
+    PerfQueryClass query_class;
+
+    static bool& active() {
+        thread_local bool measuring = false;
+        return measuring;
+    }
+
+public:
+    PerfScope(PerfProfiler* profiler, PerfQueryClass query_class) : query_class(query_class) {
+        if (!profiler || active() || !profiler->shouldSample()) {
+            return;
+        }
+        PerfCounterGroup& group = threadPerfCounters();
+        if (!group.isAvailable()) {
+            return;
+        }
+        this->profiler = profiler;
+        active() = true;
+        group.start();
+    }
+
+    ~PerfScope() {
+        if (profiler) {
+            profiler->record(query_class, threadPerfCounters().stop());
+            active() = false;
+        }
+    }
+
+    PerfScope(const PerfScope&) = delete;
+    PerfScope& operator=(const PerfScope&) = delete;
+};
+
+#endif // PERF_COUNTERS_HPP
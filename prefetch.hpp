@@ -0,0 +1,57 @@
+#ifndef PREFETCH_HPP
+#define PREFETCH_HPP
+
+#include <atomic>
+#include <cstddef>
+
+// Software prefetch hints for search loops.
+//
+// Scans read rows in order, but pages are separate allocations, so the
+// hardware prefetcher loses the stream at every page boundary; near the end of
+// a page a scan asks for the rows a fixed distance ahead in the next one. Graph
+// traversals jump between unrelated rows, which no hardware prefetcher can
+// predict; they ask for the vectors of upcoming neighbors while computing the
+// current one, and for the link list of the next node to expand. Distances are
+// process-wide and read once per search, and 0 turns a kind of hint off.
+
+constexpr size_t kPrefetchLineBytes = 64;
+constexpr size_t kDefaultScanPrefetchRows = 4;
+constexpr size_t kDefaultGraphPrefetchNeighbors = 8;
+
+inline void prefetchRead(const void* address) {
+#if defined(__GNUC__) || defined(__clang__)
+    __builtin_prefetch(address, 0, 3);
+#else
+    (void)address;
+#endif
+}
+
+// Every cache line of one row
+inline void prefetchRow(const double* row, size_t dim) {
+    const char* bytes = reinterpret_cast<const char*>(row);
+    for (size_t offset = 0; offset < dim * sizeof(double); offset += kPrefetchLineBytes) {
+        prefetchRead(bytes + offset);
+    }
+}
+
+namespace prefetch_detail {
+inline std::atomic<size_t> scan_rows{kDefaultScanPrefetchRows};
+inline std::atomic<size_t> graph_neighbors{kDefaultGraphPrefetchNeighbors};
+}  // namespace prefetch_detail
+
+// Rows ahead of the current one that scans prefetch
+inline size_t scanPrefetchRows() {
+    return prefetch_detail::scan_rows.load(std::memory_order_relaxed);
+}
+
+// Neighbor vectors ahead of the current one that graph traversals prefetch
+inline size_t graphPrefetchNeighbors() {
+    return prefetch_detail::graph_neighbors.load(std::memory_order_relaxed);
+}
+
+inline void setPrefetchDistances(size_t scan_rows, size_t graph_neighbors) {
+    prefetch_detail::scan_rows.store(scan_rows, std::memory_order_relaxed);
+    prefetch_detail::graph_neighbors.store(graph_neighbors, std::memory_order_relaxed);
+}
+
+#endif // PREFETCH_HPP
@@ -0,0 +1,236 @@
+#ifndef QUERY_TRACING_HPP
+#define QUERY_TRACING_HPP
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <mutex>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Per-search spans exported as OTLP JSON.
+//
+// Spans are timed with steady_clock and converted to Unix nanoseconds only at
+// export, from one (system, steady) anchor taken when tracing starts. A search
+// collects its spans locally and hands them over in one call when it ends,
+// so tracing costs one lock acquisition per search. Spans are written as
+// OTLP/JSON ExportTraceServiceRequest documents, one per line, which is the
+// format the OpenTelemetry collector's otlpjsonfile receiver reads.
+
+struct SpanAttribute {
+    enum class Kind { String, Int, Double };
+
+    std::string key;
+    Kind kind = Kind::String;
+    std::string string_value;
+    int64_t int_value = 0;
+    double double_value = 0.0;
+
+    static SpanAttribute text(std::string key, std::string value) {
+        SpanAttribute a;
+        a.key = std::move(key);
+        a.string_value = std::move(value);
+        return a;
+    }
+    static SpanAttribute integer(std::string key, int64_t value) {
+        SpanAttribute a;
+        a.key = std::move(key);
+        a.kind = Kind::Int;
+        a.int_value = value;
+        return a;
+    }
+    static SpanAttribute real(std::string key, double value) {
+        SpanAttribute a;
+        a.key = std::move(key);
+        a.kind = Kind::Double;
+        a.double_value = value;
+        return a;
+    }
+};
+
+struct SpanRecord {
+    uint64_t trace_id_high = 0;
+    uint64_t trace_id_low = 0;
+    uint64_t span_id = 0;
+    uint64_t parent_span_id = 0;  // 0 for the root span
+    std::string name;
+    std::chrono::steady_clock::time_point start;
+    std::chrono::steady_clock::time_point end;
+    std::vector<SpanAttribute> attributes;
+};
+
+namespace tracing_detail {
+
+inline uint64_t randomId() {
+    thread_local std::mt19937_64 gen(std::random_device{}() ^
+                                     static_cast<uint64_t>(std::chrono::steady_clock::now().time_since_epoch().count()));
+    uint64_t id;
+    do {
+        id = gen();
+    } while (id == 0);  // all-zero ids are invalid in OTLP
+    return id;
+}
+
+inline std::string hex(uint64_t value) {
+    char buffer[17];
+    std::snprintf(buffer, sizeof(buffer), "%016llx", static_cast<unsigned long long>(value));
+    return buffer;
+}
+
+inline std::string quote(const std::string& text) {
+    std::string out = "\"";
+    for (char c : text) {
+        if (c == '"' || c == '\\') {
+            out += '\\';
+            out += c;
+        } else if (static_cast<unsigned char>(c) < 0x20) {
+            char buffer[8];
+            std::snprintf(buffer, sizeof(buffer), "\\u%04x", c);
+            out += buffer;
+        } else {
+            out += c;
+        }
+    }
+    return out + "\"";
+}
+
+}  // namespace tracing_detail
+
+// Builds the spans of one traced operation under a shared trace id
+class SpanBuilder {
+private:
+    uint64_t trace_high = tracing_detail::randomId();
+    uint64_t trace_low = tracing_detail::randomId();
+    std::vector<SpanRecord> spans;
+
+public:
+    // Add a finished span; returns its id for use as a parent
+    uint64_t add(const std::string& name, uint64_t parent, std::chrono::steady_clock::time_point start,
+                 std::chrono::steady_clock::time_point end, std::vector<SpanAttribute> attributes = {}) {
+        SpanRecord span;
+        span.trace_id_high = trace_high;
+        span.trace_id_low = trace_low;
+        span.span_id = tracing_detail::randomId();
+        span.parent_span_id = parent;
+        span.name = name;
+        span.start = start;
+        span.end = end;
+        span.attributes = std::move(attributes);
+        spans.push_back(std::move(span));
+        return spans.back().span_id;
+    }
+
+    std::vector<SpanRecord> take() { return std::move(spans); }
+};
+
+// Collects finished spans and writes them to an OTLP JSON lines file
+class SpanExporter {
+private:
+    std::ofstream out;
+    std::string path;
+    std::string service_name;
+    size_t batch_spans;
+    std::mutex mtx;
+    std::vector<SpanRecord> pending;
+    uint64_t exported = 0;
+    // Anchor for converting steady_clock readings to Unix time
+    std::chrono::system_clock::time_point wall_anchor = std::chrono::system_clock::now();
+    std::chrono::steady_clock::time_point steady_anchor = std::chrono::steady_clock::now();
+
+    uint64_t unixNanos(std::chrono::steady_clock::time_point t) const {
+        auto wall = wall_anchor + std::chrono::duration_cast<std::chrono::system_clock::duration>(t - steady_anchor);
+        return static_cast<uint64_t>(
+            std::chrono::duration_cast<std::chrono::nanoseconds>(wall.time_since_epoch()).count());
+    }
+
+    static std::string attributeJson(const SpanAttribute& a) {
+        std::string value;
+        switch (a.kind) {
+            case SpanAttribute::Kind::String:
+                value = "{\"stringValue\":" + tracing_detail::quote(a.string_value) + "}";
+                break;
+            case SpanAttribute::Kind::Int:
+                // OTLP JSON encodes 64-bit integers as strings
+                value = "{\"intValue\":\"" + std::to_string(a.int_value) + "\"}";
+                break;
+            case SpanAttribute::Kind::Double: {
+                char buffer[32];
+                std::snprintf(buffer, sizeof(buffer), "%.17g", a.double_value);
+                value = std::string("{\"doubleValue\":") + buffer + "}";
+                break;
+            }
+        }
+        return "{\"key\":" + tracing_detail::quote(a.key) + ",\"value\":" + value + "}";
+    }
+
+    // Must hold `mtx`
+    void writeBatch() {
+        if (pending.empty()) {
+            return;
+        }
+        std::string line = "{\"resourceSpans\":[{\"resource\":{\"attributes\":[" +
+                           attributeJson(SpanAttribute::text("service.name", service_name)) +
+                           "]},\"scopeSpans\":[{\"scope\":{\"name\":\"vector_store\"},\"spans\":[";
+        for (size_t i = 0; i < pending.size(); ++i) {
+            const SpanRecord& span = pending[i];
+            line += i ? ",{" : "{";
+            line += "\"traceId\":\"" + tracing_detail::hex(span.trace_id_high) +
+                    tracing_detail::hex(span.trace_id_low) + "\"";
+            line += ",\"spanId\":\"" + tracing_detail::hex(span.span_id) + "\"";
+            if (span.parent_span_id) {
+                line += ",\"parentSpanId\":\"" + tracing_detail::hex(span.parent_span_id) + "\"";
+            }
+            line += ",\"name\":" + tracing_detail::quote(span.name);
+            line += ",\"kind\":" + std::string(span.parent_span_id ? "1" : "2");  // INTERNAL, SERVER
+            line += ",\"startTimeUnixNano\":\"" + std::to_string(unixNanos(span.start)) + "\"";
+            line += ",\"endTimeUnixNano\":\"" + std::to_string(unixNanos(span.end)) + "\"";
+            line += ",\"attributes\":[";
+            for (size_t a = 0; a < span.attributes.size(); ++a) {
+                line += (a ? "," : "") + attributeJson(span.attributes[a]);
+            }
+            line += "]}";
+        }
+        line += "]}]}]}\n";
+        out << line;
+        out.flush();
+        exported += pending.size();
+        pending.clear();
+    }
+
+public:
+    SpanExporter(const std::string& path, const std::string& service_name, size_t batch_spans = 512)
+        : out(path, std::ios::app), path(path), service_name(service_name), batch_spans(batch_spans) {
+        if (!out) {
+            throw std::runtime_error("Failed to open span export file: " + path);
+        }
+    }
+
+    ~SpanExporter() {
+        flush();
+    }
+
+    const std::string& getPath() const { return path; }
+
+    void submit(std::vector<SpanRecord> spans) {
+        std::lock_guard<std::mutex> lock(mtx);
+        for (auto& span : spans) {
+            pending.push_back(std::move(span));
+        }
+        if (pending.size() >= batch_spans) {
+            writeBatch();
+        }
+    }
+
+    // Write buffered spans; returns the number of spans exported so far
+    uint64_t flush() {
+        std::lock_guard<std::mutex> lock(mtx);
+        writeBatch();
+        return exported;
+    }
+};
+
+#endif // QUERY_TRACING_HPP
@@ -0,0 +1,99 @@
+#ifndef SCRATCH_ARENA_HPP
+#define SCRATCH_ARENA_HPP
+
+#include <cstddef>
+#include <memory>
+#include <memory_resource>
+#include <optional>
+
+// Per-thread scratch memory for the temporaries of one search.
+//
+// Each thread owns one arena: a buffer wrapped in a monotonic resource, so an
+// allocation is a pointer bump and nothing is freed until the search ends.
+// The outermost Scope resets the arena when it closes. If a search needed
+// more than the buffer holds, the overflow comes from the heap and the buffer
+// is regrown to the high-water mark at that reset, so after the first few
+// searches of a given size the search path stops touching the heap.
+
+constexpr size_t kScratchInitialBytes = 64 << 10;
+
+class ScratchArena {
+private:
+    // Upstream for allocations that do not fit the buffer; remembers how much
+    // was needed so the next buffer can be big enough
+    class OverflowResource : public std::pmr::memory_resource {
+    public:
+        size_t overflow_bytes = 0;
+
+    private:
+        void* do_allocate(size_t bytes, size_t alignment) override {
+            overflow_bytes += bytes;
+            return std::pmr::new_delete_resource()->allocate(bytes, alignment);
+        }
+        void do_deallocate(void* p, size_t bytes, size_t alignment) override {
+            std::pmr::new_delete_resource()->deallocate(p, bytes, alignment);
+        }
+        bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override {
+            return this == &other;
+        }
+    };
+
+    std::unique_ptr<std::byte[]> buffer;
+    size_t capacity = 0;
+    OverflowResource overflow;
+    std::optional<std::pmr::monotonic_buffer_resource> resource;
+    size_t depth = 0;  // open scopes; nested searches share the outer reset
+
+    void reserve(size_t bytes) {
+        resource.reset();
+        buffer.reset(new std::byte[bytes]);
+        capacity = bytes;
+        resource.emplace(buffer.get(), capacity, &overflow);
+    }
+
+    void leave() {
+        if (--depth > 0) {
+            return;
+        }
+        if (overflow.overflow_bytes > 0) {
+            size_t needed = capacity + overflow.overflow_bytes;
+            overflow.overflow_bytes = 0;
+            reserve(needed);  // releases the overflow chunks with the old resource
+        } else {
+            resource->release();
+        }
+    }
+
+public:
+    explicit ScratchArena(size_t initial_bytes = kScratchInitialBytes) {
+        reserve(initial_bytes);
+    }
+
+    ScratchArena(const ScratchArena&) = delete;
+    ScratchArena& operator=(const ScratchArena&) = delete;
+
+    size_t getCapacity() const { return capacity; }
+
+    // Allocations made through `memory()` stay valid until the outermost
+    // scope on this arena closes
+    class Scope {
+    private:
+        ScratchArena& arena;
+
+    public:
+        explicit Scope(ScratchArena& arena) : arena(arena) { ++arena.depth; }
+        ~Scope() { arena.leave(); }
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+
+        std::pmr::memory_resource* memory() const { return &*arena.resource; }
+    };
+};
+
+// The calling thread's arena
+inline ScratchArena& threadScratch() {
+    thread_local ScratchArena arena;
+    return arena;
+}
+
+#endif // SCRATCH_ARENA_HPP
@@ -0,0 +1,79 @@
+#ifndef SEARCH_PROFILE_HPP
+#define SEARCH_PROFILE_HPP
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <sstream>
+#include <string>
+
+// What one search did, filled in when a caller passes a SearchProfile to a
+// search method. Searches without a profile skip all of this bookkeeping.
+struct SearchProfile {
+    std::string plan;                // access path and kernel the search used
+    uint64_t data_version = 0;       // keyspace version the search read
+    size_t rows = 0;                 // rows in that version
+    size_t pages_visited = 0;        // storage pages scanned
+    size_t distance_evaluations = 0;
+    size_t candidates_filtered = 0;  // rows evaluated but not returned
+    size_t results = 0;
+    uint64_t bytes_read = 0;         // vector data read from memory
+
+    // Wall time per stage, in microseconds
+    double prepare_us = 0.0;  // validate and normalize the query
+    double scan_us = 0.0;     // distance evaluation
+    double sort_us = 0.0;     // order threshold results
+    double total_us = 0.0;
+    std::chrono::steady_clock::time_point started_at;  // when the prepare stage began
+
+    // Human-readable explain output, one stage per line
+    std::string toString() const {
+        std::ostringstream out;
+        out << "plan: " << plan << " over version " << data_version << " (" << rows << " rows)\n"
+            << "prepare: " << prepare_us << "us\n"
+            << "scan: " << scan_us << "us, " << pages_visited << " pages, " << distance_evaluations
+            << " distance evaluations, " << bytes_read << " bytes\n"
+            << "sort: " << sort_us << "us, " << results << " results, " << candidates_filtered
+            << " candidates filtered\n"
+            << "total: " << total_us << "us";
+        return out.str();
+    }
+};
+
+// Stage stopwatch for a profile; does nothing when there is no profile.
+// Starting one clears the profile, so a profile reused across searches only
+// ever describes the latest one.
+class SearchStageTimer {
+private:
+    using Clock = std::chrono::steady_clock;
+
+    SearchProfile* profile;
+    Clock::time_point start;
+    Clock::time_point last;
+
+public:
+    explicit SearchStageTimer(SearchProfile* profile) : profile(profile) {
+        if (profile) {
+            *profile = SearchProfile{};
+            start = last = Clock::now();
+            profile->started_at = start;
+        }
+    }
+
+    // Charge the time since the previous stage ended to `stage_us`
+    void endStage(double SearchProfile::*stage_us) {
+        if (profile) {
+            auto now = Clock::now();
+            profile->*stage_us += std::chrono::duration<double, std::micro>(now - last).count();
+            last = now;
+        }
+    }
+
+    void finish() {
+        if (profile) {
+            profile->total_us = std::chrono::duration<double, std::micro>(Clock::now() - start).count();
+        }
+    }
+};
+
+#endif // SEARCH_PROFILE_HPP
@@ -0,0 +1,213 @@
+#ifndef SLOW_QUERY_LOG_HPP
+#define SLOW_QUERY_LOG_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "search_profile.hpp"
+#include "storage_format.hpp"
+
+// Bounded log of searches slower than a latency threshold, with the query
+// vectors, so the exact queries behind a p99 spike can be replayed.
+//
+// Entries go into a fixed ring of slots. A writer takes the next sequence
+// number, maps it to a slot and tries to claim that slot with one CAS; if the
+// slot is busy (another writer wrapped around onto it, or a dump is copying
+// it) the entry is dropped and counted instead of waited for. Searches
+// therefore never block on the log, and a full ring overwrites its oldest
+// entries.
+//
+// Dump layout: u32 magic, u32 version, u64 count, then per entry
+//   u64 sequence, u64 unix time ns, string keyspace, u8 type, f64 threshold,
+//   f64 latency us, string plan, u64 rows, pages, evaluations, filtered,
+//   results, bytes read, f64 prepare, scan, sort, total us,
+//   u32 dimension, dimension doubles.
+
+constexpr uint32_t kSlowQueryMagic = 0x51535356;  // "VSSQ"
+constexpr uint32_t kSlowQueryFormatVersion = 1;
+
+enum class SlowQueryType : uint8_t {
+    Nearest = 0,
+    Threshold = 1,
+};
+
+struct SlowQueryEntry {
+    uint64_t sequence = 0;
+    uint64_t timestamp_ns = 0;  // wall clock, nanoseconds since the Unix epoch
+    std::string keyspace;
+    SlowQueryType type = SlowQueryType::Nearest;
+    double threshold = 0.0;     // Threshold searches only
+    double latency_us = 0.0;
+    SearchProfile profile;
+    std::vector<double> query;
+};
+
+class SlowQueryLog {
+private:
+    enum SlotState : uint32_t { kEmpty = 0, kBusy = 1, kFull = 2 };
+
+    struct Slot {
+        std::atomic<uint32_t> state{kEmpty};
+        SlowQueryEntry entry;  // owned by whoever moved `state` to kBusy
+    };
+
+    double threshold_us;
+    size_t capacity;
+    std::unique_ptr<Slot[]> slots;
+    std::atomic<uint64_t> next_sequence{0};
+    std::atomic<uint64_t> dropped{0};
+
+    // Move a slot from a stable state to kBusy; false if someone else holds it
+    static bool claim(Slot& slot, uint32_t& previous) {
+        previous = slot.state.load(std::memory_order_relaxed);
+        return previous != kBusy &&
+               slot.state.compare_exchange_strong(previous, kBusy, std::memory_order_acquire);
+    }
+
+    static void writeEntry(std::ostream& out, const SlowQueryEntry& entry) {
+        writePod(out, entry.sequence);
+        writePod(out, entry.timestamp_ns);
+        writeString(out, entry.keyspace);
+        writePod(out, static_cast<uint8_t>(entry.type));
+        writePod(out, entry.threshold);
+        writePod(out, entry.latency_us);
+        const SearchProfile& p = entry.profile;
+        writeString(out, p.plan);
+        for (uint64_t count : {static_cast<uint64_t>(p.rows), static_cast<uint64_t>(p.pages_visited),
+                               static_cast<uint64_t>(p.distance_evaluations),
+                               static_cast<uint64_t>(p.candidates_filtered), static_cast<uint64_t>(p.results),
+                               p.bytes_read}) {
+            writePod(out, count);
+        }
+        for (double us : {p.prepare_us, p.scan_us, p.sort_us, p.total_us}) {
+            writePod(out, us);
+        }
+        writePod<uint32_t>(out, static_cast<uint32_t>(entry.query.size()));
+        out.write(reinterpret_cast<const char*>(entry.query.data()), entry.query.size() * sizeof(double));
+    }
+
+public:
+    SlowQueryLog(double threshold_us, size_t capacity = 1024)
+        : threshold_us(threshold_us), capacity(capacity), slots(new Slot[capacity]) {
+        if (capacity == 0) {
+            throw std::invalid_argument("Slow query log capacity must be positive");
+        }
+    }
+
+    double getThresholdUs() const { return threshold_us; }
+    size_t getCapacity() const { return capacity; }
+
+    bool isSlow(double latency_us) const { return latency_us >= threshold_us; }
+
+    // Entries lost to slot contention since the log was created
+    uint64_t droppedCount() const { return dropped.load(std::memory_order_relaxed); }
+
+    void record(const std::string& keyspace, SlowQueryType type, double threshold, const SearchProfile& profile,
+                const double* query, size_t dimension) {
+        uint64_t sequence = next_sequence.fetch_add(1, std::memory_order_relaxed);
+        Slot& slot = slots[sequence % capacity];
+        uint32_t previous;
+        if (!claim(slot, previous)) {
+            dropped.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        SlowQueryEntry& entry = slot.entry;
+        entry.sequence = sequence;
+        entry.timestamp_ns = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::system_clock::now().time_since_epoch()).count());
+        entry.keyspace = keyspace;
+        entry.type = type;
+        entry.threshold = threshold;
+        entry.latency_us = profile.total_us;
+        entry.profile = profile;
+        entry.query.assign(query, query + dimension);
+        slot.state.store(kFull, std::memory_order_release);
+    }
+
+    // Copy of the entries currently in the ring, oldest first. Slots being
+    // written at the moment are skipped.
+    std::vector<SlowQueryEntry> entries() const {
+        std::vector<SlowQueryEntry> out;
+        for (size_t i = 0; i < capacity; ++i) {
+            Slot& slot = slots[i];
+            uint32_t previous;
+            if (!claim(slot, previous)) {
+                continue;
+            }
+            if (previous == kFull) {
+                out.push_back(slot.entry);
+            }
+            slot.state.store(previous, std::memory_order_release);
+        }
+        std::sort(out.begin(), out.end(),
+                  [](const SlowQueryEntry& a, const SlowQueryEntry& b) { return a.sequence < b.sequence; });
+        return out;
+    }
+
+    // Write the current entries to `path`; returns how many were written
+    size_t dump(const std::string& path) const {
+        std::vector<SlowQueryEntry> snapshot = entries();
+        std::ofstream out(path, std::ios::binary | std::ios::trunc);
+        if (!out) {
+            throw std::runtime_error("Failed to open slow query dump for writing: " + path);
+        }
+        writePod(out, kSlowQueryMagic);
+        writePod(out, kSlowQueryFormatVersion);
+        writePod<uint64_t>(out, snapshot.size());
+        for (const SlowQueryEntry& entry : snapshot) {
+            writeEntry(out, entry);
+        }
+        if (!out) {
+            throw std::runtime_error("Failed to write slow query dump: " + path);
+        }
+        return snapshot.size();
+    }
+};
+
+// Read a file written by SlowQueryLog::dump
+inline std::vector<SlowQueryEntry> readSlowQueryDump(const std::string& path) {
+    std::ifstream in(path, std::ios::binary);
+    if (!in) {
+        throw std::runtime_error("Failed to open slow query dump: " + path);
+    }
+    if (readPod<uint32_t>(in) != kSlowQueryMagic) {
+        throw std::runtime_error("Not a slow query dump: " + path);
+    }
+    if (readPod<uint32_t>(in) != kSlowQueryFormatVersion) {
+        throw std::runtime_error("Unsupported slow query dump version: " + path);
+    }
+    std::vector<SlowQueryEntry> entries(readPod<uint64_t>(in));
+    for (SlowQueryEntry& entry : entries) {
+        entry.sequence = readPod<uint64_t>(in);
+        entry.timestamp_ns = readPod<uint64_t>(in);
+        entry.keyspace = readString(in);
+        entry.type = static_cast<SlowQueryType>(readPod<uint8_t>(in));
+        entry.threshold = readPod<double>(in);
+        entry.latency_us = readPod<double>(in);
+        SearchProfile& p = entry.profile;
+        p.plan = readString(in);
+        p.rows = readPod<uint64_t>(in);
+        p.pages_visited = readPod<uint64_t>(in);
+        p.distance_evaluations = readPod<uint64_t>(in);
+        p.candidates_filtered = readPod<uint64_t>(in);
+        p.results = readPod<uint64_t>(in);
+        p.bytes_read = readPod<uint64_t>(in);
+        p.prepare_us = readPod<double>(in);
+        p.scan_us = readPod<double>(in);
+        p.sort_us = readPod<double>(in);
+        p.total_us = readPod<double>(in);
+        entry.query.resize(readPod<uint32_t>(in));
+        if (!in.read(reinterpret_cast<char*>(entry.query.data()), entry.query.size() * sizeof(double))) {
+            throw std::runtime_error("Truncated slow query dump: " + path);
+        }
+    }
+    return entries;
+}
+
+#endif // SLOW_QUERY_LOG_HPP
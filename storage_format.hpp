@@ -0,0 +1,249 @@
+#ifndef STORAGE_FORMAT_HPP
+#define STORAGE_FORMAT_HPP
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+#include <fcntl.h>
+#include <unistd.h>
+#include "keyspace_spec.hpp"
+#include "float_codec.hpp"
+
+// On-disk layout of a persisted VectorStore directory:
+//
+//   catalog.vsc       - names and metadata of every keyspace, plus aliases (read at startup)
+//   <fnv64>-<gen>.vks - one data file per keyspace, loaded on first access
+//   wal_<id>.log      - write-ahead log segments written since the last checkpoint
+//
+// Data files are never rewritten in place: each save writes them under a new
+// generation, and renaming the new catalog over the old one is the single
+// commit point. Files of older generations are removed after that.
+//
+// Keyspace data files are split into fixed-size segments, each protected by a
+// CRC32C checksum, so they can be read and verified on several threads. Each
+// segment is stored with its own codec (see float_codec.hpp).
+//
+// All integers and vector elements are written in native (little-endian) byte order.
+
+constexpr uint32_t kCatalogMagic = 0x43535356;      // "VSSC"
+constexpr uint32_t kKeyspaceFileMagic = 0x4B535356; // "VSSK"
+constexpr uint32_t kStorageFormatVersion = 8;
+constexpr uint64_t kSegmentTargetBytes = 1 << 20;
+constexpr const char* kCatalogFileName = "catalog.vsc";
+
+// Metadata kept in the catalog for every keyspace
+struct KeyspaceCatalogEntry {
+    std::string name;
+    KeyspaceSpec spec;
+    uint64_t count = 0;
+    uint32_t prewarm_priority = 0;  // 0 = load on demand only
+    uint64_t last_lsn = 0;          // last WAL record contained in the data file
+    uint64_t last_sequence = 0;     // last change-stream sequence contained in the data file
+    uint64_t generation = 0;        // save that wrote the data file (part of its name)
+};
+
+// Contents of the catalog file
+struct StoreCatalog {
+    uint64_t generation = 0;  // most recent save into this directory
+    std::vector<KeyspaceCatalogEntry> keyspaces;
+    std::vector<std::pair<std::string, std::string>> aliases;  // alias -> keyspace
+};
+
+// Fixed-size header at the start of every keyspace data file
+struct KeyspaceFileHeader {
+    uint32_t magic = kKeyspaceFileMagic;
+    uint32_t version = kStorageFormatVersion;
+    uint64_t dimension = 0;
+    uint64_t count = 0;
+    uint64_t last_lsn = 0;
+    uint64_t segment_rows = 0;  // rows per checksummed segment
+    // followed by one KeyspaceSegmentInfo per segment, then the segments back to back
+};
+
+// Directory entry of one data file segment
+struct KeyspaceSegmentInfo {
+    uint64_t stored_bytes = 0;  // size of the segment as stored
+    uint32_t checksum = 0;      // CRC32C of the stored bytes
+    SegmentCodec codec = SegmentCodec::Raw;
+};
+
+// Rows per segment so that a segment is roughly kSegmentTargetBytes
+inline uint64_t segmentRowsFor(uint64_t dimension) {
+    uint64_t row_bytes = std::max<uint64_t>(1, dimension) * sizeof(double);
+    return std::max<uint64_t>(1, kSegmentTargetBytes / row_bytes);
+}
+
+template <typename T>
+inline void writePod(std::ostream& out, const T& value) {
+    out.write(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+template <typename T>
+inline T readPod(std::istream& in) {
+    T value{};
+    if (!in.read(reinterpret_cast<char*>(&value), sizeof(T))) {
+        throw std::runtime_error("Unexpected end of file");
+    }
+    return value;
+}
+
+inline void writeString(std::ostream& out, const std::string& value) {
+    writePod<uint32_t>(out, static_cast<uint32_t>(value.size()));
+    out.write(value.data(), value.size());
+}
+
+inline std::string readString(std::istream& in) {
+    uint32_t length = readPod<uint32_t>(in);
+    std::string value(length, '\0');
+    if (length > 0 && !in.read(&value[0], length)) {
+        throw std::runtime_error("Unexpected end of file");
+    }
+    return value;
+}
+
+// File name of a keyspace's data file (FNV-1a of the keyspace name) as written by save `generation`
+inline std::string keyspaceFileName(const std::string& name, uint64_t generation) {
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    for (unsigned char c : name) {
+        hash ^= c;
+        hash *= 0x100000001b3ULL;
+    }
+    char buffer[48];
+    std::snprintf(buffer, sizeof(buffer), "%016llx-%llu.vks", static_cast<unsigned long long>(hash),
+                  static_cast<unsigned long long>(generation));
+    return buffer;
+}
+
+// Flush a written file to the device
+inline void syncFile(const std::string& path) {
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw std::runtime_error("Failed to open for sync: " + path);
+    }
+    int result = ::fsync(fd);
+    ::close(fd);
+    if (result != 0) {
+        throw std::runtime_error("Failed to sync: " + path);
+    }
+}
+
+// Make renames and newly created files in a directory durable
+inline void syncDirectory(const std::string& path) {
+    int fd = ::open(path.c_str(), O_RDONLY | O_DIRECTORY);
+    if (fd < 0) {
+        throw std::runtime_error("Failed to open directory for sync: " + path);
+    }
+    int result = ::fsync(fd);
+    ::close(fd);
+    if (result != 0) {
+        throw std::runtime_error("Failed to sync directory: " + path);
+    }
+}
+
+inline void writeSpec(std::ostream& out, const KeyspaceSpec& spec) {
+    writePod<uint64_t>(out, spec.dimension);
+    writePod(out, static_cast<uint8_t>(spec.element_type));
+    writePod(out, static_cast<uint8_t>(spec.metric));
+    writePod<uint8_t>(out, spec.normalize ? 1 : 0);
+    writePod(out, static_cast<uint8_t>(spec.index));
+    writePod(out, static_cast<uint8_t>(spec.storage));
+    writePod(out, spec.graph.degree);
+    writePod(out, spec.graph.build_width);
+    writePod(out, spec.graph.search_width);
+}
+
+inline KeyspaceSpec readSpec(std::istream& in) {
+    KeyspaceSpec spec;
+    spec.dimension = readPod<uint64_t>(in);
+    spec.element_type = static_cast<ElementType>(readPod<uint8_t>(in));
+    spec.metric = static_cast<DistanceMetric>(readPod<uint8_t>(in));
+    spec.normalize = readPod<uint8_t>(in) != 0;
+    spec.index = static_cast<IndexType>(readPod<uint8_t>(in));
+    spec.storage = static_cast<StorageTier>(readPod<uint8_t>(in));
+    spec.graph.degree = readPod<uint32_t>(in);
+    spec.graph.build_width = readPod<uint32_t>(in);
+    spec.graph.search_width = readPod<uint32_t>(in);
+    spec.validate();
+    return spec;
+}
+
+// Atomically replace the catalog. Data files it references must already be
+// synced; on return the new catalog is durable.
+inline void writeCatalog(const std::string& path, const StoreCatalog& catalog) {
+    // Write to a temporary file first so a crash never leaves a torn catalog behind
+    std::string tmp_path = path + ".tmp";
+    {
+        std::ofstream out(tmp_path, std::ios::binary | std::ios::trunc);
+        if (!out) {
+            throw std::runtime_error("Failed to open catalog for writing: " + tmp_path);
+        }
+        writePod(out, kCatalogMagic);
+        writePod(out, kStorageFormatVersion);
+        writePod(out, catalog.generation);
+        writePod<uint64_t>(out, catalog.keyspaces.size());
+        for (const auto& entry : catalog.keyspaces) {
+            writeString(out, entry.name);
+            writeSpec(out, entry.spec);
+            writePod(out, entry.count);
+            writePod(out, entry.prewarm_priority);
+            writePod(out, entry.last_lsn);
+            writePod(out, entry.last_sequence);
+            writePod(out, entry.generation);
+        }
+        writePod<uint64_t>(out, catalog.aliases.size());
+        for (const auto& [alias, keyspace] : catalog.aliases) {
+            writeString(out, alias);
+            writeString(out, keyspace);
+        }
+        if (!out) {
+            throw std::runtime_error("Failed to write catalog: " + tmp_path);
+        }
+    }
+    syncFile(tmp_path);
+    if (std::rename(tmp_path.c_str(), path.c_str()) != 0) {
+        throw std::runtime_error("Failed to replace catalog: " + path);
+    }
+    size_t slash = path.find_last_of('/');
+    syncDirectory(slash == std::string::npos ? "." : path.substr(0, slash + 1));
+}
+
+inline StoreCatalog readCatalog(const std::string& path) {
+    std::ifstream in(path, std::ios::binary);
+    if (!in) {
+        throw std::runtime_error("Failed to open catalog: " + path);
+    }
+    if (readPod<uint32_t>(in) != kCatalogMagic) {
+        throw std::runtime_error("Not a VectorStore catalog: " + path);
+    }
+    if (readPod<uint32_t>(in) != kStorageFormatVersion) {
+        throw std::runtime_error("Unsupported catalog version: " + path);
+    }
+    StoreCatalog catalog;
+    catalog.generation = readPod<uint64_t>(in);
+    uint64_t count = readPod<uint64_t>(in);
+    catalog.keyspaces.reserve(count);
+    for (uint64_t i = 0; i < count; ++i) {
+        KeyspaceCatalogEntry entry;
+        entry.name = readString(in);
+        entry.spec = readSpec(in);
+        entry.count = readPod<uint64_t>(in);
+        entry.prewarm_priority = readPod<uint32_t>(in);
+        entry.last_lsn = readPod<uint64_t>(in);
+        entry.last_sequence = readPod<uint64_t>(in);
+        entry.generation = readPod<uint64_t>(in);
+        catalog.keyspaces.push_back(std::move(entry));
+    }
+    uint64_t alias_count = readPod<uint64_t>(in);
+    for (uint64_t i = 0; i < alias_count; ++i) {
+        std::string alias = readString(in);
+        catalog.aliases.emplace_back(std::move(alias), readString(in));
+    }
+    return catalog;
+}
+
+#endif // STORAGE_FORMAT_HPP
@@ -1,33 +1,38 @@
 #include "vector_store.hpp"
+#include "dataset_generator.hpp"
+#include "bench_report.hpp"
 #include <spdlog/spdlog.h>
+#include <algorithm>
 #include <chrono>
-#include <random>
 #include <vector>
 #include <memory>
 #include <iomanip>
+#include <string>
+
+// Usage: test_benchmark [--json PATH] [--calibrate CACHE] [--perf-sample N]
+//
+// With --perf-sample N one in every N searches is measured with hardware
+// performance counters. Off by default, because reading the counters adds
+// syscalls to the timed searches.
 
 using namespace std::chrono;
 
-// Helper function to create a Vector from float values
-Vector createVectorFromFloat(const std::vector<float>& floatVec) {
-    Vector vec(floatVec.size());
-    for (size_t i = 0; i < floatVec.size(); ++i) {
-        vec[i] = static_cast<double>(floatVec[i]);
-    }
-    return vec;
-}
+// Helper function to generate reproducible random vectors, uniform in [-1, 1)
+std::vector<Vector> generateRandomVectors(size_t count, size_t dimension, uint64_t seed) {
+    DatasetSpec spec;
+    spec.count = count;
+    spec.dimension = dimension;
+    spec.seed = seed;
+    std::vector<double> values = generateDataset(spec);
 
-// Helper function to generate random vectors
-std::vector<float> generateRandomVector(size_t dimension) {
-    std::random_device rd;
-    std::mt19937 gen(rd());
-    std::uniform_real_distribution<float> dis(-1.0f, 1.0f);
-    
-    std::vector<float> vec(dimension);
-    for (size_t i = 0; i < dimension; ++i) {
-        vec[i] = dis(gen);
+    std::vector<Vector> vectors;
+    vectors.reserve(count);
+    for (size_t i = 0; i < count; ++i) {
+        Vector vec(dimension);
+        std::copy(values.begin() + i * dimension, values.begin() + (i + 1) * dimension, vec.getData());
+        vectors.push_back(std::move(vec));
     }
-    return vec;
+    return vectors;
 }
 
 // Helper function to measure memory usage
@@ -37,7 +42,12 @@ size_t getCurrentMemoryUsage() {
     return sizeof(VectorStore) + sizeof(Keyspace);
 }
 
-void runBenchmark(size_t numVectors, size_t vectorDimension, size_t numKeyspaces) {
+// Timed phases are split into this many chunks so each metric has enough
+// samples for bench_compare to tell a regression from noise
+constexpr size_t kSampleChunks = 100;
+
+void runBenchmark(const std::string& scale, size_t numVectors, size_t vectorDimension, size_t numKeyspaces,
+                  size_t perfSample, BenchReport& report) {
     spdlog::info("Starting benchmark with {} vectors of dimension {} in {} keyspaces", 
                  numVectors, vectorDimension, numKeyspaces);
 
@@ -47,6 +57,9 @@ void runBenchmark(size_t numVectors, size_t vectorDimension, size_t numKeyspaces
     auto end = high_resolution_clock::now();
     auto duration = duration_cast<microseconds>(end - start);
     spdlog::info("Store creation time: {} microseconds", duration.count());
+    if (perfSample > 0) {
+        store.enablePerfCounters(perfSample);
+    }
 
     // Create keyspaces
     std::vector<std::shared_ptr<Keyspace>> keyspaces;
@@ -55,27 +68,34 @@ void runBenchmark(size_t numVectors, size_t vectorDimension, size_t numKeyspaces
     }
 
     // Create vectors for benchmark
-    std::vector<Vector> vectors;
-    for (size_t i = 0; i < numVectors; ++i) {
-        auto floatVec = generateRandomVector(vectorDimension);
-        vectors.push_back(createVectorFromFloat(floatVec));
-    }
+    std::vector<Vector> vectors = generateRandomVectors(numVectors, vectorDimension, 1);
+    std::vector<Vector> queries = generateRandomVectors(100, vectorDimension, 2);
 
     // Measure insertion time
+    size_t chunkSize = std::max<size_t>(1, numVectors / kSampleChunks);
+    std::vector<double> insertSamples;
     start = high_resolution_clock::now();
+    auto chunkStart = start;
     for (size_t i = 0; i < numVectors; ++i) {
         keyspaces[i % numKeyspaces]->addVector(vectors[i]);
+        if ((i + 1) % chunkSize == 0) {
+            auto now = high_resolution_clock::now();
+            insertSamples.push_back(std::chrono::duration<double, std::micro>(now - chunkStart).count() / chunkSize);
+            chunkStart = now;
+        }
     }
     end = high_resolution_clock::now();
+    report.addSamples(scale + ".insert_per_vector", "us", insertSamples);
     duration = duration_cast<microseconds>(end - start);
     spdlog::info("Insertion time for {} vectors: {} microseconds ({} microseconds per vector)", 
                  numVectors, duration.count(), duration.count() / numVectors);
 
     // Measure search time
+    std::vector<double> searchSamples;
     start = high_resolution_clock::now();
     for (size_t i = 0; i < 100; ++i) {  // Perform 100 searches
-        auto queryFloatVec = generateRandomVector(vectorDimension);
-        Vector queryVec = createVectorFromFloat(queryFloatVec);
+        const Vector& queryVec = queries[i];
+        auto searchStart = high_resolution_clock::now();
         try {
             size_t nearestIdx = keyspaces[0]->findNearestNeighbor(queryVec);
             // Also test threshold search
@@ -83,8 +103,16 @@ void runBenchmark(size_t numVectors, size_t vectorDimension, size_t numKeyspaces
         } catch (const std::exception& e) {
             // Handle empty keyspace case
         }
+        searchSamples.push_back(std::chrono::duration<double, std::micro>(high_resolution_clock::now() - searchStart).count());
     }
     end = high_resolution_clock::now();
+    report.addSamples(scale + ".search", "us", searchSamples);
+    for (const auto& summary : store.getPerfCounters()) {
+        if (summary.samples > 0) {
+            spdlog::info("Counters {}", formatPerfSummary(summary));
+        }
+    }
+    report.addPerfCounters(scale + ".", store.getPerfCounters());
     duration = duration_cast<microseconds>(end - start);
     spdlog::info("Average search time: {} microseconds per search", duration.count() / 100);
 
@@ -93,31 +121,74 @@ void runBenchmark(size_t numVectors, size_t vectorDimension, size_t numKeyspaces
     spdlog::info("Estimated memory usage: {} bytes", memoryUsage);
 
     // Measure deletion time
+    std::vector<double> deleteSamples;
     start = high_resolution_clock::now();
+    chunkStart = start;
     for (size_t i = 0; i < numVectors; ++i) {
         size_t keyspaceIdx = i % numKeyspaces;
         if (keyspaces[keyspaceIdx]->size() > 0) {
             keyspaces[keyspaceIdx]->removeVector(0);  // Always remove the first vector
         }
+        if ((i + 1) % chunkSize == 0) {
+            auto now = high_resolution_clock::now();
+            deleteSamples.push_back(std::chrono::duration<double, std::micro>(now - chunkStart).count() / chunkSize);
+            chunkStart = now;
+        }
     }
     end = high_resolution_clock::now();
+    report.addSamples(scale + ".delete_per_vector", "us", deleteSamples);
     duration = duration_cast<microseconds>(end - start);
     spdlog::info("Deletion time for {} vectors: {} microseconds ({} microseconds per vector)", 
                  numVectors, duration.count(), duration.count() / numVectors);
 }
 
-int main() {
+int main(int argc, char** argv) {
     spdlog::set_level(spdlog::level::info);
-    
+    std::string jsonPath;
+    std::string calibrationCache;
+    size_t perfSample = 0;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--json" && i + 1 < argc) {
+            jsonPath = argv[++i];
+        } else if (arg == "--calibrate" && i + 1 < argc) {
+            calibrationCache = argv[++i];
+        } else if (arg == "--perf-sample" && i + 1 < argc) {
+            perfSample = std::stoul(argv[++i]);
+        } else {
+            spdlog::error("Usage: test_benchmark [--json PATH] [--calibrate CACHE] [--perf-sample N]");
+            return 1;
+        }
+    }
+    if (!calibrationCache.empty()) {
+        VectorStore::calibrateKernels(calibrationCache);
+    }
+
+    BenchReport report("test_benchmark");
+    report.setDataset("distribution", "uniform");
+    report.setDataset("range", "[-1, 1)");
+    report.setDataset("seed", 1);
+    report.setDataset("query_seed", 2);
+    report.setParameter("queries", 100);
+    report.setParameter("threshold", 0.5);
+    report.setParameter("calibrated_kernels", !calibrationCache.empty());
+    report.setParameter("perf_sample", perfSample);
+    report.setParameter("scales", "small: 1000 x 128 in 5 keyspaces, medium: 10000 x 256 in 10, "
+                                  "large: 100000 x 512 in 20");
+
     // Run benchmarks with different sizes
     spdlog::info("\n=== Small Scale Benchmark ===");
-    runBenchmark(1000, 128, 5);
+    runBenchmark("small", 1000, 128, 5, perfSample, report);
     
     spdlog::info("\n=== Medium Scale Benchmark ===");
-    runBenchmark(10000, 256, 10);
+    runBenchmark("medium", 10000, 256, 10, perfSample, report);
     
     spdlog::info("\n=== Large Scale Benchmark ===");
-    runBenchmark(100000, 512, 20);
+    runBenchmark("large", 100000, 512, 20, perfSample, report);
 
+    if (!jsonPath.empty()) {
+        report.writeToFile(jsonPath);
+        spdlog::info("Wrote benchmark report to {}", jsonPath);
+    }
     return 0;
 } 
\ No newline at end of file
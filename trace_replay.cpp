@@ -0,0 +1,231 @@
+#include "vector_store.hpp"
+#include "workload_trace.hpp"
+#include "bench_report.hpp"
+#include <spdlog/spdlog.h>
+#include <algorithm>
+#include <chrono>
+#include <set>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+// Re-issue a workload trace recorded with VectorStore::startTrace.
+//
+// Events are replayed in trace order on one thread, each at its recorded
+// offset divided by --speed (0 replays as fast as possible). Latency is
+// measured from the scheduled time, so a build that falls behind the original
+// traffic shows it in the percentiles. Keyspaces missing from the target store
+// are created from the specs in the trace.
+//
+// TRACE may also be a dump written by VectorStore::dumpSlowQueries. Its
+// queries are re-run one after another against the keyspaces of --store, and
+// each new latency is printed next to the one originally logged.
+//
+// Usage: trace_replay TRACE [--speed FACTOR] [--store DIRECTORY] [--json PATH]
+
+using namespace std::chrono;
+
+struct ReplayOptions {
+    std::string trace_path;
+    double speed = 1.0;
+    std::string store_directory;  // empty = fresh in-memory store
+    std::string json_path;        // write a benchmark report when set
+};
+
+const char* eventName(TraceEventType type) {
+    switch (type) {
+        case TraceEventType::DefineKeyspace: return "define";
+        case TraceEventType::SearchNearest: return "nearest";
+        case TraceEventType::SearchThreshold: return "threshold";
+        case TraceEventType::Insert: return "insert";
+        case TraceEventType::Remove: return "remove";
+        case TraceEventType::Update: return "update";
+        case TraceEventType::Upsert: return "upsert";
+    }
+    return "unknown";
+}
+
+ReplayOptions parseOptions(int argc, char** argv) {
+    ReplayOptions options;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg.rfind("--", 0) != 0) {
+            options.trace_path = arg;
+            continue;
+        }
+        if (i + 1 >= argc) {
+            throw std::invalid_argument("Missing value for " + arg);
+        }
+        std::string value = argv[++i];
+        if (arg == "--speed") options.speed = std::stod(value);
+        else if (arg == "--store") options.store_directory = value;
+        else if (arg == "--json") options.json_path = value;
+        else throw std::invalid_argument("Unknown option: " + arg);
+    }
+    if (options.trace_path.empty()) {
+        throw std::invalid_argument("Usage: trace_replay TRACE [--speed FACTOR] [--store DIRECTORY] [--json PATH]");
+    }
+    return options;
+}
+
+Vector toVector(const std::vector<double>& values) {
+    Vector vec(values.size());
+    std::copy(values.begin(), values.end(), vec.getData());
+    return vec;
+}
+
+bool isSlowQueryDump(const std::string& path) {
+    std::ifstream in(path, std::ios::binary);
+    uint32_t magic = 0;
+    in.read(reinterpret_cast<char*>(&magic), sizeof(magic));
+    return in && magic == kSlowQueryMagic;
+}
+
+void replaySlowQueries(const std::string& path, VectorStore& store) {
+    std::vector<SlowQueryEntry> entries = readSlowQueryDump(path);
+    spdlog::info("Replaying {} slow queries", entries.size());
+    for (const SlowQueryEntry& entry : entries) {
+        SearchProfile profile;
+        try {
+            auto keyspace = store.getKeyspace(entry.keyspace);
+            Vector query = toVector(entry.query);
+            if (entry.type == SlowQueryType::Threshold) {
+                keyspace->findNeighborsAboveThreshold(query, entry.threshold, &profile);
+            } else {
+                keyspace->findNearestNeighbor(query, &profile);
+            }
+            spdlog::info("#{} {} {}: logged {:.1f}us over {} rows, now {:.1f}us over {} rows", entry.sequence,
+                         entry.keyspace, entry.type == SlowQueryType::Threshold ? "threshold" : "nearest",
+                         entry.latency_us, entry.profile.rows, profile.total_us, profile.rows);
+        } catch (const std::exception& e) {
+            spdlog::warn("#{} {}: {}", entry.sequence, entry.keyspace, e.what());
+        }
+    }
+}
+
+void applyEvent(const TraceEvent& event, Keyspace& keyspace) {
+    switch (event.type) {
+        case TraceEventType::SearchNearest:
+            keyspace.findNearestNeighbor(toVector(event.values));
+            break;
+        case TraceEventType::SearchThreshold:
+            keyspace.findNeighborsAboveThreshold(toVector(event.values), event.threshold);
+            break;
+        case TraceEventType::Insert:
+            keyspace.addVector(toVector(event.values));
+            break;
+        case TraceEventType::Remove:
+            keyspace.removeVector(event.index);
+            break;
+        case TraceEventType::Update:
+            keyspace.updateVector(event.index, toVector(event.values));
+            break;
+        case TraceEventType::Upsert: {
+            WriteBatch batch;
+            batch.upsert(event.index, toVector(event.values));
+            keyspace.applyBatch(batch);
+            break;
+        }
+        case TraceEventType::DefineKeyspace:
+            break;
+    }
+}
+
+int main(int argc, char** argv) {
+    ReplayOptions options;
+    try {
+        options = parseOptions(argc, argv);
+    } catch (const std::exception& e) {
+        spdlog::error("{}", e.what());
+        return 1;
+    }
+
+    try {
+        std::unique_ptr<VectorStore> store = options.store_directory.empty()
+            ? std::make_unique<VectorStore>("trace_replay_store")
+            : std::make_unique<VectorStore>("trace_replay_store", options.store_directory);
+        if (isSlowQueryDump(options.trace_path)) {
+            replaySlowQueries(options.trace_path, *store);
+            return 0;
+        }
+        TraceReader reader(options.trace_path);
+
+        std::unordered_map<uint32_t, std::shared_ptr<Keyspace>> keyspaces;
+        std::unordered_map<int, std::vector<double>> latencies_us;
+        std::unordered_map<int, size_t> errors;
+        size_t events = 0;
+        TraceEvent event;
+        auto start = steady_clock::now();
+        while (reader.next(event)) {
+            if (event.type == TraceEventType::DefineKeyspace) {
+                auto existing = store->listKeyspaces();
+                bool found = std::find(existing.begin(), existing.end(), event.name) != existing.end();
+                keyspaces[event.keyspace] = found ? store->getKeyspace(event.name)
+                                                  : store->createKeyspace(event.spec, event.name);
+                continue;
+            }
+            auto keyspace_it = keyspaces.find(event.keyspace);
+            if (keyspace_it == keyspaces.end()) {
+                throw std::runtime_error("Trace event refers to an undefined keyspace");
+            }
+
+            auto scheduled = steady_clock::now();
+            if (options.speed > 0) {
+                scheduled = start + duration_cast<steady_clock::duration>(
+                    nanoseconds(event.timestamp_ns) / options.speed);
+                std::this_thread::sleep_until(scheduled);
+            }
+            int type = static_cast<int>(event.type);
+            try {
+                applyEvent(event, *keyspace_it->second);
+                latencies_us[type].push_back(duration<double, std::micro>(steady_clock::now() - scheduled).count());
+            } catch (const std::exception&) {
+                ++errors[type];
+            }
+            ++events;
+        }
+        double elapsed = duration<double>(steady_clock::now() - start).count();
+
+        spdlog::info("Replayed {} events in {:.2f}s ({:.0f} events/s) at speed {}",
+                     events, elapsed, events / elapsed, options.speed);
+        BenchReport report("trace_replay");
+        report.setDataset("trace", options.trace_path);
+        report.setDataset("events", events);
+        report.setParameter("speed", options.speed);
+        report.setParameter("store", options.store_directory.empty() ? "in-memory" : options.store_directory);
+        report.addSample("replay.throughput", "events/s", events / elapsed, false);
+        // Types where every operation failed have no latencies but must still be reported
+        std::set<int> types;
+        for (const auto& [type, samples] : latencies_us) {
+            types.insert(type);
+        }
+        for (const auto& [type, count] : errors) {
+            types.insert(type);
+        }
+        for (int type : types) {
+            std::string name = eventName(static_cast<TraceEventType>(type));
+            std::vector<double>& samples = latencies_us[type];
+            report.addSample(name + ".failed", "ops", static_cast<double>(errors[type]));
+            if (samples.empty()) {
+                spdlog::info("{:<9} {:>9} ops  failed {}", name, 0, errors[type]);
+                continue;
+            }
+            report.addSamples(name + ".latency", "us", samples);
+            std::sort(samples.begin(), samples.end());
+            auto at = [&](double q) {
+                return samples[std::min(samples.size() - 1, static_cast<size_t>(q * samples.size()))];
+            };
+            spdlog::info("{:<9} {:>9} ops  p50 {:.1f}us  p99 {:.1f}us  max {:.1f}us  failed {}",
+                         name, samples.size(), at(0.5), at(0.99), samples.back(), errors[type]);
+        }
+        if (!options.json_path.empty()) {
+            report.writeToFile(options.json_path);
+            spdlog::info("Wrote benchmark report to {}", options.json_path);
+        }
+    } catch (const std::exception& e) {
+        spdlog::error("Replay failed: {}", e.what());
+        return 1;
+    }
+    return 0;
+}
@@ -6,8 +6,32 @@
 #include <cmath>
 #include <stdexcept>
 #include <utility>  // for std::pair
+#include <limits>
 #include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <thread>
+#include <algorithm>
+#include <unordered_map>
+#include <filesystem>
 #include <spdlog/spdlog.h>
+#include "storage_format.hpp"
+#include "write_ahead_log.hpp"
+#include "parallel_for.hpp"
+#include "keyspace_storage.hpp"
+#include "keyspace_spec.hpp"
+#include "distance_kernels.hpp"
+#include "kernel_calibration.hpp"
+#include "change_stream.hpp"
+#include "keyspace_export.hpp"
+#include "workload_trace.hpp"
+#include "perf_counters.hpp"
+#include "search_profile.hpp"
+#include "slow_query_log.hpp"
+#include "query_tracing.hpp"
+#include "keyspace_stats.hpp"
+#include "scratch_arena.hpp"
+#include "graph_index.hpp"
 
 class Vector {
 private:
@@ -42,24 +66,747 @@ public:
         return data[index];
     }
 
+    // Raw element storage
+    double* getData() { return data.data(); }
+    const double* getData() const { return data.data(); }
+};
+
+// Mixed inserts, removes and upserts applied to a keyspace as one unit. Each
+// operation sees the keyspace as left by the operations before it, so indices
+// refer to rows after earlier removes and inserts of the same batch.
+class WriteBatch {
+public:
+    enum class OpType {
+        Insert,
+        Remove,
+        Upsert,  // replace the row at `index`, or append when there is no such row
+    };
+
+    struct Operation {
+        OpType type;
+        size_t index;
+        std::vector<double> values;
+    };
+
+private:
+    std::vector<Operation> ops;
+
+public:
+    WriteBatch& insert(const Vector& vec) {
+        ops.push_back({OpType::Insert, 0, std::vector<double>(vec.getData(), vec.getData() + vec.getDimension())});
+        return *this;
+    }
+
+    WriteBatch& remove(size_t index) {
+        ops.push_back({OpType::Remove, index, {}});
+        return *this;
+    }
+
+    WriteBatch& upsert(size_t index, const Vector& vec) {
+        ops.push_back({OpType::Upsert, index, std::vector<double>(vec.getData(), vec.getData() + vec.getDimension())});
+        return *this;
+    }
 
+    size_t size() const { return ops.size(); }
+    bool empty() const { return ops.empty(); }
+    const std::vector<Operation>& operations() const { return ops; }
 };
 
+// Point-in-time view of a keyspace. A snapshot pins one published version, so
+// every query against it sees the same rows no matter what writers do in the
+// meantime. Taking a snapshot is a single atomic load and never waits on a
+// writer; pages only reachable from old versions are freed once the last
+// snapshot holding them goes away.
+class KeyspaceSnapshot {
+private:
+    std::shared_ptr<const KeyspaceData> data;
+    KeyspaceSpec spec;
+    const SearchKernels* kernels;
+    std::shared_ptr<const GraphIndex> graph;  // covers a prefix of `data`, or null to scan
+
+    const double* queryForm(const Vector& query, std::pmr::vector<double>& buffer) const {
+        if (data->count == 0) {
+            throw std::runtime_error("Vector store is empty");
+        }
+        if (query.getDimension() != spec.dimension) {
+            throw std::runtime_error("Vector dimension does not match keyspace dimension");
+        }
+        if (!spec.normalize) {
+            return query.getData();
+        }
+        buffer.assign(query.getData(), query.getData() + spec.dimension);
+        normalizeInPlace(buffer.data(), spec.dimension);
+        return buffer.data();
+    }
+
+    void checkWeights(const DimensionWeights* weights) const {
+        if (weights && weights->dimension() != spec.dimension) {
+            throw std::runtime_error("Weight dimension does not match keyspace dimension");
+        }
+    }
+
+    // A full scan evaluates every row of every page exactly once
+    void describeScan(SearchProfile& profile, size_t results, const DimensionWeights* weights) const {
+        size_t dimensions_read = spec.dimension;
+        if (!weights) {
+            profile.plan = std::string("full scan, ") + kernels->name + " kernel, " + std::to_string(kernels->lanes) +
+                           " lanes x " + std::to_string(kernels->tile) + " rows per pass";
+        } else {
+            profile.plan = std::string("full scan, ") + kernels->weighted_name + " kernel, ";
+            if (weights->isMask()) {
+                dimensions_read = weights->activeDimensions().size();
+                profile.plan += "masked to " + std::to_string(dimensions_read) + " of " +
+                                std::to_string(spec.dimension) + " dimensions, ";
+            } else {
+                profile.plan += "weighted, ";
+            }
+            profile.plan += std::to_string(kernels->weighted_lanes) + " lanes x " +
+                            std::to_string(kernels->weighted_tile) + " rows per pass";
+        }
+        profile.data_version = data->version;
+        profile.rows = data->count;
+        profile.pages_visited = data->pageCount();
+        profile.distance_evaluations = data->count;
+        profile.results = results;
+        profile.candidates_filtered = data->count - results;
+        profile.bytes_read = static_cast<uint64_t>(data->count) * dimensions_read * sizeof(double);
+    }
+
+    // A graph search evaluates only the rows its traversal reached, plus
+    // every row appended after the graph's version
+    void describeGraphSearch(SearchProfile& profile, const GraphSearchStats& stats) const {
+        size_t scanned = rowsOutsideGraph();
+        profile.plan = std::string("graph search, width ") + std::to_string(spec.graph.search_width) + ", " +
+                       kernels->name + " kernel, " + std::to_string(stats.nodes_expanded) + " nodes expanded";
+        if (scanned > 0) {
+            profile.plan += ", " + std::to_string(scanned) + " newer rows scanned";
+        }
+        size_t evaluations = stats.distance_evaluations + scanned;
+        profile.data_version = data->version;
+        profile.rows = data->count;
+        profile.distance_evaluations = evaluations;
+        profile.results = 1;
+        profile.candidates_filtered = evaluations - 1;
+        profile.bytes_read = static_cast<uint64_t>(evaluations) * spec.dimension * sizeof(double);
+    }
+
+    // Nearest of rows [first, count) by a kernel scan. The rest of the page
+    // holding `first` is compared row by row, whole pages after it by the
+    // keyspace's scan over a page table of just those pages.
+    size_t nearestFrom(size_t first, const double* query) const {
+        auto [page, offset] = data->locate(first);
+        size_t nearest = first;
+        double best = std::numeric_limits<double>::infinity();
+        if (offset > 0) {
+            const double* row = data->table->page(page)->row(offset);
+            for (size_t r = offset; r < data->rowsInPage(page); ++r, row += spec.dimension) {
+                double d = kernels->distance(query, row, spec.dimension);
+                if (d < best) {
+                    best = d;
+                    nearest = data->firstRow(page) + r;
+                }
+            }
+            ++page;
+        }
+        if (page < data->pageCount()) {
+            size_t base = data->firstRow(page);
+            auto table = std::make_shared<PageTable>();
+            for (size_t p = page; p < data->pageCount(); ++p) {
+                table->pushPage(data->table->page(p), data->firstRow(p) - base);
+            }
+            KeyspaceData rest{table, data->count - base, data->version, data->rewritten_version};
+            size_t candidate = base + kernels->nearest(rest, query, spec.dimension);
+            if (kernels->distance(query, data->row(candidate), spec.dimension) < best) {
+                nearest = candidate;
+            }
+        }
+        return nearest;
+    }
+
+    // Shared by the search overloads below; `weights` is null when unweighted
+    size_t nearest(const Vector& query, const DimensionWeights* weights, SearchProfile* profile) const {
+        SearchStageTimer timer(profile);
+        ScratchArena::Scope scratch(threadScratch());
+        std::pmr::vector<double> buffer(scratch.memory());
+        const double* prepared = queryForm(query, buffer);
+        checkWeights(weights);
+        timer.endStage(&SearchProfile::prepare_us);
+        if (weights) {
+            size_t nearest = kernels->weighted_nearest(*data, prepared, spec.dimension, *weights);
+            timer.endStage(&SearchProfile::scan_us);
+            if (profile) {
+                describeScan(*profile, 1, weights);
+            }
+            timer.finish();
+            return nearest;
+        }
+        if (graph) {
+            GraphSearchStats stats;
+            size_t covered = data->count - rowsOutsideGraph();
+            size_t nearest = graph->findNearest(prepared, covered, spec.graph.search_width, &stats);
+            if (covered < data->count) {
+                size_t newer = nearestFrom(covered, prepared);
+                if (kernels->distance(prepared, data->row(newer), spec.dimension) <
+                    kernels->distance(prepared, data->row(nearest), spec.dimension)) {
+                    nearest = newer;
+                }
+            }
+            timer.endStage(&SearchProfile::scan_us);
+            if (profile) {
+                describeGraphSearch(*profile, stats);
+            }
+            timer.finish();
+            return nearest;
+        }
+        size_t nearest = kernels->nearest(*data, prepared, spec.dimension);
+        timer.endStage(&SearchProfile::scan_us);
+        if (profile) {
+            describeScan(*profile, 1, nullptr);
+        }
+        timer.finish();
+        return nearest;
+    }
+
+    void aboveThreshold(const Vector& query, double threshold, const DimensionWeights* weights,
+                        std::vector<std::pair<size_t, double>>& results, SearchProfile* profile) const {
+        SearchStageTimer timer(profile);
+        results.clear();
+        ScratchArena::Scope scratch(threadScratch());
+        std::pmr::vector<double> buffer(scratch.memory());
+        const double* prepared = queryForm(query, buffer);
+        checkWeights(weights);
+        timer.endStage(&SearchProfile::prepare_us);
+        if (weights) {
+            kernels->weighted_threshold(*data, prepared, spec.dimension, threshold, *weights, results);
+        } else {
+            kernels->threshold(*data, prepared, spec.dimension, threshold, results);
+        }
+        timer.endStage(&SearchProfile::scan_us);
+        std::sort(results.begin(), results.end(),
+            [](const auto& a, const auto& b) {
+                return a.second > b.second;
+            }
+        );
+        timer.endStage(&SearchProfile::sort_us);
+        if (profile) {
+            describeScan(*profile, results.size(), weights);
+        }
+        timer.finish();
+    }
+
+public:
+    KeyspaceSnapshot(std::shared_ptr<const KeyspaceData> data, const KeyspaceSpec& spec, const SearchKernels* kernels,
+                     std::shared_ptr<const GraphIndex> graph = nullptr)
+        : data(std::move(data)), spec(spec), kernels(kernels), graph(std::move(graph)) {}
+
+    size_t size() const { return data->count; }
+    size_t getDimension() const { return spec.dimension; }
+    const KeyspaceSpec& getSpec() const { return spec; }
+
+    // Version number of the pinned contents; increases with every write
+    uint64_t getVersion() const { return data->version; }
+
+    // Whether nearest searches use a graph instead of scanning
+    bool hasGraph() const { return graph != nullptr; }
+
+    // Rows a nearest search scans: those the graph does not cover yet, or all
+    // of them without a graph
+    size_t rowsOutsideGraph() const {
+        return graph ? data->count - std::min(graph->size(), data->count) : data->count;
+    }
+
+    // Pinned contents, for scans that walk the pages directly
+    const KeyspaceData& getData() const { return *data; }
+
+    // Copy of the vector at `index`
+    Vector getVector(size_t index) const {
+        if (index >= data->count) {
+            throw std::runtime_error("Vector index out of range");
+        }
+        Vector vec(spec.dimension);
+        std::copy(data->row(index), data->row(index) + spec.dimension, vec.getData());
+        return vec;
+    }
+
+    // Find nearest neighbor under the keyspace's distance metric. When
+    // `profile` is given it receives what the search did. Snapshots of Graph
+    // keyspaces that carry a graph answer approximately from it.
+    size_t findNearestNeighbor(const Vector& query, SearchProfile* profile = nullptr) const {
+        return nearest(query, nullptr, profile);
+    }
+
+    // Nearest neighbor with each dimension's term scaled by `weights`, or
+    // restricted to the kept dimensions of a mask. Always an exact scan,
+    // since a graph is built for unweighted distances.
+    size_t findNearestNeighbor(const Vector& query, const DimensionWeights& weights,
+                               SearchProfile* profile = nullptr) const {
+        return nearest(query, &weights, profile);
+    }
+
+    // Find all neighbors above similarity threshold, most similar first
+    std::vector<std::pair<size_t, double>> findNeighborsAboveThreshold(const Vector& query, double threshold,
+                                                                       SearchProfile* profile = nullptr) const {
+        std::vector<std::pair<size_t, double>> results;
+        aboveThreshold(query, threshold, nullptr, results, profile);
+        return results;
+    }
+
+    // Same, into `results`, replacing its contents. Reusing one vector across
+    // searches keeps its capacity, so repeated searches do not allocate.
+    void findNeighborsAboveThreshold(const Vector& query, double threshold,
+                                     std::vector<std::pair<size_t, double>>& results,
+                                     SearchProfile* profile = nullptr) const {
+        aboveThreshold(query, threshold, nullptr, results, profile);
+    }
+
+    // Threshold search under `weights`; similarities are computed with the
+    // weighted distance
+    std::vector<std::pair<size_t, double>> findNeighborsAboveThreshold(const Vector& query, double threshold,
+                                                                       const DimensionWeights& weights,
+                                                                       SearchProfile* profile = nullptr) const {
+        std::vector<std::pair<size_t, double>> results;
+        aboveThreshold(query, threshold, &weights, results, profile);
+        return results;
+    }
+
+    void findNeighborsAboveThreshold(const Vector& query, double threshold, const DimensionWeights& weights,
+                                     std::vector<std::pair<size_t, double>>& results,
+                                     SearchProfile* profile = nullptr) const {
+        aboveThreshold(query, threshold, &weights, results, profile);
+    }
+};
 
 class Keyspace {
 private:
-    std::vector<Vector> vectors;
+    // Current version of the contents. Readers take it with std::atomic_load and
+    // keep using that version; writers publish a new one under `mtx`.
+    std::shared_ptr<const KeyspaceData> data = std::make_shared<KeyspaceData>();
+    KeyspaceSpec spec;
     size_t dimension;
-    std::mutex mtx;
+    const SearchKernels* kernels;  // specialized for `spec` at construction
+    mutable std::mutex mtx;
     std::string keyspace_name;
+    uint32_t prewarm_priority = 0;
+    std::shared_ptr<WriteAheadLog> wal;
+    uint64_t last_lsn = 0;
+    uint64_t change_sequence = 0;  // sequence of the last insert, update or delete
+    // WAL records holding this keyspace's changes, in sequence order, so that
+    // reads behind the ring seek straight to them. Guarded by `mtx`.
+    struct LoggedChanges {
+        uint64_t first_sequence;
+        uint64_t last_sequence;
+        WalLocation location;
+    };
+    std::vector<LoggedChanges> logged_changes;
+    // Ring of recent changes, created on first subscription; read with std::atomic_load
+    mutable std::shared_ptr<ChangeStream> changes;
+    // Set while the owning store records a workload trace; read with std::atomic_load
+    std::shared_ptr<const TraceBinding> trace;
+    // Set while the owning store samples hardware counters; read with std::atomic_load
+    std::shared_ptr<PerfProfiler> perf;
+    // Set while the owning store logs slow queries; read with std::atomic_load
+    std::shared_ptr<SlowQueryLog> slow_queries;
+    // Graph of a recent version for Graph keyspaces; read with std::atomic_load.
+    // A background builder brings it up to date after writes, so neither
+    // writers nor searches wait on a build.
+    mutable std::shared_ptr<const GraphIndex> graph;
+    mutable std::mutex graph_build_mtx;  // held while a graph is built or extended
+    mutable std::mutex graph_mtx;        // guards the builder thread and the flags below
+    mutable std::thread graph_builder;
+    mutable std::condition_variable graph_wake;  // a new version was requested, or stopping
+    mutable bool graph_building = false;
+    bool graph_stopping = false;
+    mutable std::atomic<uint64_t> graph_requested{0};  // latest version the builder was asked for
+    std::atomic<bool> graph_cancel{false};
+    // Operation counts, striped per thread so searches never share a counter line
+    mutable StripedCounters stats;
+
+    std::shared_ptr<const KeyspaceData> currentData() const {
+        return std::atomic_load(&data);
+    }
+
+    void publish(std::shared_ptr<const KeyspaceData> next) {
+        std::atomic_store(&data, std::move(next));
+    }
+
+    // Log a mutation as the next change without waiting for it to be durable.
+    // Returns its LSN, or 0 when the keyspace is not logged. Must hold `mtx`.
+    uint64_t logChange(WalRecord& record) {
+        record.sequence = change_sequence + 1;
+        if (!wal) {
+            return 0;
+        }
+        last_lsn = wal->write(record);
+        indexLoggedChanges(record);
+        return last_lsn;
+    }
+
+    // Release `lock` on `mtx`, then wait until the change logged as `lsn` is
+    // durable. Waiting outside the lock lets writers of one keyspace share a sync.
+    void commitChange(std::unique_lock<std::mutex>& lock, uint64_t lsn) const {
+        std::shared_ptr<WriteAheadLog> log = wal;
+        lock.unlock();
+        if (log && lsn > 0) {
+            log->waitDurable(lsn);
+        }
+    }
+
+    // Remember where a logged record's changes are. Must hold `mtx`.
+    void indexLoggedChanges(const WalRecord& record) {
+        if (record.sequence == 0) {
+            return;  // initial contents, not a change
+        }
+        uint64_t count = record.op == WalOp::WriteBatch ? record.entries.size() : 1;
+        if (count == 0) {
+            return;
+        }
+        logged_changes.push_back({record.sequence, record.sequence + count - 1, record.location});
+    }
+
+    // Make a mutation visible to change subscribers. Must hold `mtx`.
+    void emitChange(ChangeType type, uint64_t index, const double* row) {
+        ++change_sequence;
+        if (auto ring = std::atomic_load(&changes)) {
+            ring->publish(change_sequence, type, index, row);
+        }
+    }
+
+    // Changes after `cursor` recovered from the WAL once they have left the
+    // ring. Only the records holding the requested changes are read.
+    std::vector<ChangeEvent> readLoggedChanges(const ChangeCursor& cursor, size_t max_events) const {
+        std::shared_ptr<WriteAheadLog> log;
+        uint64_t last;
+        std::vector<LoggedChanges> wanted;
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            log = wal;
+            last = change_sequence;
+            auto it = std::upper_bound(logged_changes.begin(), logged_changes.end(), cursor.next_sequence,
+                                       [](uint64_t sequence, const LoggedChanges& changes) {
+                                           return sequence < changes.first_sequence;
+                                       });
+            if (it != logged_changes.begin()) {
+                --it;
+            }
+            for (uint64_t covered = 0; it != logged_changes.end() && covered < max_events; ++it) {
+                wanted.push_back(*it);
+                covered += it->last_sequence - std::max(it->first_sequence, cursor.next_sequence) + 1;
+            }
+        }
+        if (!log) {
+            throw std::runtime_error("Change cursor expired for keyspace: " + keyspace_name);
+        }
+        std::vector<ChangeEvent> events;
+        WriteAheadLog::Reader reader(log->getDirectory());
+        WalRecord record;
+        for (const LoggedChanges& changes : wanted) {
+            if (!reader.read(changes.location, record) || record.sequence != changes.first_sequence) {
+                break;  // removed by a checkpoint
+            }
+            uint64_t sequence = record.sequence;
+            const double* row = record.values.data();
+            for (const WalBatchEntry& entry : entriesOf(record)) {
+                ChangeEvent event;
+                event.sequence = sequence++;
+                event.index = entry.index;
+                event.type = entry.op == WalOp::AddVector ? ChangeType::Insert :
+                             entry.op == WalOp::UpdateVector ? ChangeType::Update : ChangeType::Delete;
+                if (event.type != ChangeType::Delete) {
+                    event.values.assign(row, row + dimension);
+                    row += dimension;
+                }
+                if (event.sequence >= cursor.next_sequence && event.sequence <= last) {
+                    events.push_back(std::move(event));
+                }
+            }
+        }
+        if (!events.empty() && events.front().sequence != cursor.next_sequence) {
+            events.clear();
+        }
+        if (events.empty() && cursor.next_sequence <= last) {
+            throw std::runtime_error("Change cursor expired for keyspace: " + keyspace_name);
+        }
+        if (events.size() > max_events) {
+            events.resize(max_events);
+        }
+        return events;
+    }
+
+    // Form in which a vector is stored and compared: unit length when the spec
+    // asks for normalization, otherwise the vector's own data
+    const double* storedForm(const double* values, std::vector<double>& buffer) const {
+        if (!spec.normalize) {
+            return values;
+        }
+        buffer.assign(values, values + dimension);
+        normalizeInPlace(buffer.data(), dimension);
+        return buffer.data();
+    }
+
+    const double* storedForm(const Vector& vec, std::vector<double>& buffer) const {
+        return storedForm(vec.getData(), buffer);
+    }
+
+    // The mutations recorded by a WAL record, as batch entries
+    static std::vector<WalBatchEntry> entriesOf(const WalRecord& record) {
+        if (record.op == WalOp::WriteBatch) {
+            return record.entries;
+        }
+        return {WalBatchEntry{record.op, record.index}};
+    }
+
+    // Apply mutations to `builder`, taking the rows of inserts and updates from
+    // `values` in order. Throws on the first invalid entry, leaving the
+    // published version untouched. Returns the row each entry applied to.
+    std::vector<uint64_t> applyEntries(KeyspaceDataBuilder& builder, const std::vector<WalBatchEntry>& entries,
+                                       const std::vector<double>& values) const {
+        std::vector<uint64_t> rows;
+        rows.reserve(entries.size());
+        size_t offset = 0;
+        for (const WalBatchEntry& entry : entries) {
+            if (entry.op == WalOp::RemoveVector) {
+                if (entry.index >= builder.size()) {
+                    throw std::out_of_range("Index out of bounds");
+                }
+                builder.remove(entry.index);
+                rows.push_back(entry.index);
+                continue;
+            }
+            if (offset + dimension > values.size()) {
+                throw std::runtime_error("Vector dimension does not match keyspace dimension");
+            }
+            if (entry.op == WalOp::AddVector) {
+                rows.push_back(builder.size());
+                builder.append(values.data() + offset);
+            } else if (entry.op == WalOp::UpdateVector && entry.index < builder.size()) {
+                builder.update(entry.index, values.data() + offset);
+                rows.push_back(entry.index);
+            } else if (entry.op == WalOp::UpdateVector) {
+                throw std::out_of_range("Index out of bounds");
+            } else {
+                throw std::runtime_error("Not a row-level WAL operation");
+            }
+            offset += dimension;
+        }
+        if (offset != values.size()) {
+            throw std::runtime_error("Vector dimension does not match keyspace dimension");
+        }
+        return rows;
+    }
+
+    // Emit the changes of applied entries, the first one numbered `first_sequence`. Must hold `mtx`.
+    void emitChanges(uint64_t first_sequence, const std::vector<WalBatchEntry>& entries,
+                     const std::vector<uint64_t>& rows, const std::vector<double>& values) {
+        change_sequence = first_sequence - 1;
+        size_t offset = 0;
+        for (size_t i = 0; i < entries.size(); ++i) {
+            if (entries[i].op == WalOp::RemoveVector) {
+                emitChange(ChangeType::Delete, rows[i], nullptr);
+                continue;
+            }
+            ChangeType type = entries[i].op == WalOp::AddVector ? ChangeType::Insert : ChangeType::Update;
+            emitChange(type, rows[i], values.data() + offset);
+            offset += dimension;
+        }
+    }
+
+    // Whether `built` answers for the rows of `current`: no version between
+    // the two removed or updated rows, so rows both hold are the same rows
+    static bool graphCovers(const GraphIndex& built, const KeyspaceData& current) {
+        uint64_t older = std::min(built.getVersion(), current.version);
+        return std::max(built.getRewrittenVersion(), current.rewritten_version) <= older;
+    }
+
+    // Latest graph usable for `current`, or null. Never builds: a graph that
+    // is missing or behind is brought up to date in the background, and
+    // searches scan the rows it does not cover meanwhile.
+    std::shared_ptr<const GraphIndex> graphFor(const std::shared_ptr<const KeyspaceData>& current) const {
+        if (spec.index != IndexType::Graph || current->count == 0) {
+            return nullptr;
+        }
+        auto built = std::atomic_load(&graph);
+        if (!built || built->getVersion() < current->version) {
+            requestGraphUpdate(current->version);
+        }
+        return built && graphCovers(*built, *current) ? built : nullptr;
+    }
+
+    // Have the background builder bring the graph up to at least `version`,
+    // starting it if it is idle
+    void requestGraphUpdate(uint64_t version) const {
+        if (spec.index != IndexType::Graph) {
+            return;
+        }
+        uint64_t requested = graph_requested.load(std::memory_order_relaxed);
+        do {
+            if (requested >= version) {
+                return;  // the builder will get there
+            }
+        } while (!graph_requested.compare_exchange_weak(requested, version));
+        std::lock_guard<std::mutex> lock(graph_mtx);
+        if (graph_stopping) {
+            return;
+        }
+        if (graph_building) {
+            graph_wake.notify_one();
+            return;
+        }
+        if (graph_builder.joinable()) {
+            graph_builder.join();  // already past its last update
+        }
+        graph_building = true;
+        graph_builder = std::thread([this]() { runGraphBuilder(); });
+    }
+
+    // Background builder: updates the graph until it has reached every
+    // requested version, and exits once no write has asked for an update for
+    // kGraphBuilderLinger, so a stream of small writes reuses one thread
+    void runGraphBuilder() const {
+        while (true) {
+            auto current = currentData();
+            try {
+                updateGraph(current);
+            } catch (const std::exception& e) {
+                spdlog::error("Failed to update graph index for keyspace {}: {}", keyspace_name, e.what());
+            }
+            std::unique_lock<std::mutex> lock(graph_mtx);
+            bool requested = graph_wake.wait_for(lock, kGraphBuilderLinger, [&]() {
+                return graph_stopping || graph_requested.load() > current->version;
+            });
+            if (!requested || graph_stopping) {
+                graph_building = false;
+                return;
+            }
+        }
+    }
+
+    // Bring the graph up to `current`: extend the published graph when rows
+    // were only appended since, rebuild it otherwise. Long builds publish as
+    // they go, each step at least doubling the rows covered, so searches scan
+    // less of the keyspace while they run.
+    void updateGraph(const std::shared_ptr<const KeyspaceData>& current) const {
+        std::lock_guard<std::mutex> lock(graph_build_mtx);
+        auto built = std::atomic_load(&graph);
+        if (current->count == 0 || (built && built->getVersion() > current->version) ||
+            (built && built->getVersion() == current->version && built->size() == current->count)) {
+            return;
+        }
+        auto profiler = std::atomic_load(&perf);
+        PerfScope counters(profiler.get(), PerfQueryClass::Build);
+        auto start = std::chrono::steady_clock::now();
+        bool replace = !built || !graphCovers(*built, *current);  // published graph no longer usable
+        std::shared_ptr<const GraphIndex> next = replace ? nullptr : built;
+        bool rebuilt = replace;
+        while ((!next || next->size() < current->count) && !graph_cancel) {
+            size_t done = next ? next->size() : 0;
+            size_t end = std::max(2 * done, done + kGraphPublishRows);
+            std::shared_ptr<const GraphIndex> step;
+            if (next) {
+                step = next->extendedTo(current, end, &graph_cancel);
+            }
+            if (!step) {
+                rebuilt = true;  // nothing to extend, or a row outgrew the inner product augmentation
+                step = std::make_shared<const GraphIndex>(current, spec, *kernels, end, &graph_cancel);
+            }
+            if (replace || step->size() >= built->size()) {
+                std::atomic_store(&graph, step);
+            }
+            next = std::move(step);
+        }
+        if (graph_cancel) {
+            return;
+        }
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        if (rebuilt) {
+            spdlog::info("Built graph index for keyspace {}: {} rows, {:.1f} links per row, {:.2f}s", keyspace_name,
+                         next->size(), next->averageDegree(), seconds);
+        } else {
+            spdlog::debug("Extended graph index for keyspace {} to {} rows in {:.3f}s", keyspace_name, next->size(),
+                          seconds);
+        }
+    }
+
+    // Searches wrapped in tracing, perf counters, stats and slow query logging.
+    // Weights are not part of the trace format, so weighted searches replay as
+    // plain ones.
+    size_t searchNearest(const Vector& query, const DimensionWeights* weights, SearchProfile* profile) const {
+        if (auto binding = std::atomic_load(&trace)) {
+            binding->recorder->recordSearch(binding->keyspace_id, query.getData(), query.getDimension());
+        }
+        auto current = currentData();
+        // The graph's links come from unweighted distances, so weighted searches scan
+        auto index = weights ? nullptr : graphFor(current);
+        auto profiler = std::atomic_load(&perf);
+        PerfScope counters(profiler.get(), PerfQueryClass::Nearest);
+        auto slow_log = std::atomic_load(&slow_queries);
+        SearchProfile timing;  // slow query detection needs a profile even if the caller passed none
+        if (slow_log && !profile) {
+            profile = &timing;
+        }
+        KeyspaceSnapshot pinned(current, spec, kernels, std::move(index));
+        size_t nearest = weights ? pinned.findNearestNeighbor(query, *weights, profile)
+                                 : pinned.findNearestNeighbor(query, profile);
+        stats.add(KeyspaceCounter::NearestSearches);
+        stats.add(KeyspaceCounter::RowsScanned, pinned.rowsOutsideGraph());
+        if (slow_log && slow_log->isSlow(profile->total_us)) {
+            slow_log->record(keyspace_name, SlowQueryType::Nearest, 0.0, *profile, query.getData(),
+                             query.getDimension());
+        }
+        return nearest;
+    }
+
+    void searchAboveThreshold(const Vector& query, double threshold, const DimensionWeights* weights,
+                              std::vector<std::pair<size_t, double>>& results, SearchProfile* profile) const {
+        if (auto binding = std::atomic_load(&trace)) {
+            binding->recorder->recordThresholdSearch(binding->keyspace_id, query.getData(), query.getDimension(),
+                                                     threshold);
+        }
+        auto profiler = std::atomic_load(&perf);
+        PerfScope counters(profiler.get(), PerfQueryClass::Threshold);
+        auto slow_log = std::atomic_load(&slow_queries);
+        SearchProfile timing;
+        if (slow_log && !profile) {
+            profile = &timing;
+        }
+        KeyspaceSnapshot pinned = snapshot();
+        if (weights) {
+            pinned.findNeighborsAboveThreshold(query, threshold, *weights, results, profile);
+        } else {
+            pinned.findNeighborsAboveThreshold(query, threshold, results, profile);
+        }
+        stats.add(KeyspaceCounter::ThresholdSearches);
+        stats.add(KeyspaceCounter::ThresholdResults, results.size());
+        stats.add(KeyspaceCounter::RowsScanned, pinned.size());
+        if (slow_log && slow_log->isSlow(profile->total_us)) {
+            slow_log->record(keyspace_name, SlowQueryType::Threshold, threshold, *profile, query.getData(),
+                             query.getDimension());
+        }
+    }
 public:
     // Constructor
-    Keyspace(size_t dim, std::string name) : dimension(dim), keyspace_name(name) {
-        spdlog::info("Created keyspace: {}", name);
+    Keyspace(size_t dim, std::string name) : Keyspace(KeyspaceSpec(dim), std::move(name)) {}
+
+    Keyspace(const KeyspaceSpec& keyspace_spec, std::string name)
+        : spec(keyspace_spec), dimension(keyspace_spec.dimension), keyspace_name(name) {
+        spec.validate();
+        kernels = &selectSearchKernels(spec);
+        spdlog::info("Created keyspace: {} ({} dimensions, {} kernel, {} lanes x {} rows per pass)", name, dimension,
+                     kernels->name, kernels->lanes, kernels->tile);
     }
 
     // Destructor
     ~Keyspace() {
+        graph_cancel = true;
+        std::thread builder;
+        {
+            std::lock_guard<std::mutex> lock(graph_mtx);
+            graph_stopping = true;
+            builder = std::move(graph_builder);
+        }
+        graph_wake.notify_all();
+        if (builder.joinable()) {
+            builder.join();
+        }
         spdlog::info("Destroyed keyspace: {}", keyspace_name);
     }
 
@@ -69,12 +816,323 @@ public:
 
     // Get number of vectors
     size_t size() const {
-        return vectors.size();
+        return currentData()->count;
     }
 
     // Get the dimension of vectors in the store
     size_t getDimension() const { return dimension; }
 
+    const KeyspaceSpec& getSpec() const { return spec; }
+
+    // Background prewarm order when loaded lazily from disk (0 = load on demand only)
+    uint32_t getPrewarmPriority() const { return prewarm_priority; }
+    void setPrewarmPriority(uint32_t priority) { prewarm_priority = priority; }
+
+    // Last WAL record applied to this keyspace
+    uint64_t getLastLsn() const {
+        std::lock_guard<std::mutex> lock(mtx);
+        return last_lsn;
+    }
+
+    // Record every subsequent operation to `recorder`, or stop recording when null
+    void setTraceRecorder(const std::shared_ptr<TraceRecorder>& recorder) {
+        std::shared_ptr<const TraceBinding> binding;
+        if (recorder) {
+            binding = std::make_shared<TraceBinding>(TraceBinding{recorder, recorder->defineKeyspace(keyspace_name, spec)});
+        }
+        std::atomic_store(&trace, binding);
+    }
+
+    // Count searches and batch builds into `profiler`, or stop when null
+    void setPerfProfiler(const std::shared_ptr<PerfProfiler>& profiler) {
+        std::atomic_store(&perf, profiler);
+    }
+
+    // Log searches slower than the log's threshold, or stop when null
+    void setSlowQueryLog(const std::shared_ptr<SlowQueryLog>& log) {
+        std::atomic_store(&slow_queries, log);
+    }
+
+    // Operation counts summed over all threads since the keyspace was opened
+    KeyspaceStats getStats() const {
+        return stats.snapshot();
+    }
+
+    // Sequence number of the last insert, update or delete
+    uint64_t getChangeSequence() const {
+        std::lock_guard<std::mutex> lock(mtx);
+        return change_sequence;
+    }
+
+    // Buffer the most recent `capacity` changes in memory for subscribers.
+    // Called implicitly with a default capacity by the first readChanges.
+    void enableChangeStream(size_t capacity = 1024) const {
+        if (capacity == 0) {
+            throw std::invalid_argument("Change stream capacity must be positive");
+        }
+        std::lock_guard<std::mutex> lock(mtx);
+        if (!changes) {
+            std::atomic_store(&changes, std::make_shared<ChangeStream>(capacity, dimension, change_sequence));
+        }
+    }
+
+    // Up to `max_events` changes starting at `cursor`, which is advanced past
+    // them. Recent changes come from the in-memory ring without taking the
+    // keyspace lock; older ones are read back from the WAL. Throws when the
+    // changes at `cursor` are no longer available (ring overrun with the WAL
+    // checkpointed past them, or a Memory-tier keyspace).
+    std::vector<ChangeEvent> readChanges(ChangeCursor& cursor, size_t max_events = 1024) const {
+        auto ring = std::atomic_load(&changes);
+        if (!ring) {
+            enableChangeStream();
+            ring = std::atomic_load(&changes);
+        }
+        std::vector<ChangeEvent> events;
+        if (cursor.next_sequence == 0 ||
+            ring->read(cursor.next_sequence, max_events, events) != ChangeStream::ReadStatus::Ok) {
+            events = readLoggedChanges(cursor, max_events);
+        }
+        if (!events.empty()) {
+            cursor.next_sequence = events.back().sequence + 1;
+        }
+        return events;
+    }
+
+    // Log every subsequent mutation to `log`. With `log_contents`, the keyspace
+    // itself and its current vectors are logged first so replay can rebuild it.
+    // Memory-tier keyspaces are never logged.
+    void attachWriteAheadLog(std::shared_ptr<WriteAheadLog> log, bool log_contents) {
+        std::lock_guard<std::mutex> lock(mtx);
+        if (spec.storage == StorageTier::Memory) {
+            return;
+        }
+        wal = std::move(log);
+        if (wal && log_contents) {
+            // The existing contents are the starting state, not changes: the
+            // create record carries the current sequence and the rows none
+            WalRecord create = WalRecord::createKeyspace(keyspace_name, spec);
+            create.sequence = change_sequence;
+            last_lsn = wal->write(create);
+            auto current = currentData();
+            for (size_t i = 0; i < current->count; ++i) {
+                WalRecord add = WalRecord::addVector(keyspace_name, current->row(i), dimension);
+                last_lsn = wal->write(add);
+            }
+            wal->waitDurable(last_lsn);
+        }
+    }
+
+    // Re-apply a logged mutation during recovery (not logged again)
+    void applyWalRecord(const WalRecord& record) {
+        std::lock_guard<std::mutex> lock(mtx);
+        KeyspaceDataBuilder builder(*data, dimension);
+        std::vector<WalBatchEntry> entries;
+        std::vector<uint64_t> rows;
+        switch (record.op) {
+            case WalOp::AddVector:
+            case WalOp::RemoveVector:
+            case WalOp::UpdateVector:
+            case WalOp::WriteBatch:
+                entries = entriesOf(record);
+                rows = applyEntries(builder, entries, record.values);
+                break;
+            case WalOp::CreateKeyspace:
+                change_sequence = record.sequence;
+                break;
+            case WalOp::CloneKeyspace:
+                break;
+            default:
+                throw std::runtime_error("Not a keyspace-level WAL record");
+        }
+        publish(builder.build());
+        last_lsn = record.lsn;
+        if (record.sequence != 0 && !entries.empty()) {
+            emitChanges(record.sequence, entries, rows, record.values);
+            indexLoggedChanges(record);
+        }
+    }
+
+    // Index a logged change that recovery skipped because the data file
+    // already contains it; it stays readable until the next checkpoint
+    void indexRecoveredChanges(const WalRecord& record) {
+        std::lock_guard<std::mutex> lock(mtx);
+        if (record.op == WalOp::CreateKeyspace || record.op == WalOp::CloneKeyspace ||
+            record.op == WalOp::DropKeyspace) {
+            logged_changes.clear();  // changes before it belong to an earlier keyspace of the same name
+            return;
+        }
+        indexLoggedChanges(record);
+    }
+
+    // Drop the index of changes whose WAL segments a checkpoint removed
+    void forgetLoggedChanges(uint64_t last_segment_id) {
+        std::lock_guard<std::mutex> lock(mtx);
+        auto kept = std::find_if(logged_changes.begin(), logged_changes.end(), [&](const LoggedChanges& changes) {
+            return changes.location.segment_id > last_segment_id;
+        });
+        logged_changes.erase(logged_changes.begin(), kept);
+    }
+
+    // Write all vectors to a keyspace data file and sync it. Returns the catalog
+    // entry describing exactly what was written.
+    KeyspaceCatalogEntry saveToFile(const std::string& path,
+                                    SegmentCodec codec = SegmentCodec::ShuffleHuffman) const {
+        // Write from a pinned version so writers are not blocked during I/O
+        std::shared_ptr<const KeyspaceData> snapshot;
+        KeyspaceCatalogEntry entry;
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            snapshot = data;
+            entry.name = keyspace_name;
+            entry.spec = spec;
+            entry.count = snapshot->count;
+            entry.prewarm_priority = prewarm_priority;
+            entry.last_lsn = last_lsn;
+            entry.last_sequence = change_sequence;
+        }
+
+        std::ofstream out(path, std::ios::binary | std::ios::trunc);
+        if (!out) {
+            throw std::runtime_error("Failed to open keyspace file for writing: " + path);
+        }
+        KeyspaceFileHeader header;
+        header.dimension = dimension;
+        header.count = entry.count;
+        header.last_lsn = entry.last_lsn;
+        header.segment_rows = segmentRowsFor(dimension);
+
+        size_t segment_count = (header.count + header.segment_rows - 1) / header.segment_rows;
+        std::vector<KeyspaceSegmentInfo> segments(segment_count);
+        writePod(out, header);
+        out.write(reinterpret_cast<const char*>(segments.data()), segments.size() * sizeof(KeyspaceSegmentInfo));
+
+        // Encode a thread's worth of segments at a time, then write them in order
+        size_t batch = std::max<size_t>(1, std::thread::hardware_concurrency());
+        std::vector<std::string> encoded(batch);
+        for (size_t first = 0; first < segment_count; first += batch) {
+            size_t n = std::min(batch, segment_count - first);
+            parallelFor(n, [&](size_t i) {
+                size_t first_row = (first + i) * header.segment_rows;
+                size_t rows = std::min<size_t>(header.segment_rows, header.count - first_row);
+                std::vector<double> values(rows * dimension);
+                for (size_t r = 0; r < rows; ++r) {
+                    std::copy(snapshot->row(first_row + r), snapshot->row(first_row + r) + dimension,
+                              values.begin() + r * dimension);
+                }
+                KeyspaceSegmentInfo& info = segments[first + i];
+                encoded[i] = encodeFloatSegment(values.data(), values.size(), codec, info.codec);
+                info.stored_bytes = encoded[i].size();
+                info.checksum = crc32c(encoded[i].data(), encoded[i].size());
+            });
+            for (size_t i = 0; i < n; ++i) {
+                out.write(encoded[i].data(), encoded[i].size());
+            }
+        }
+        out.seekp(sizeof(KeyspaceFileHeader));
+        out.write(reinterpret_cast<const char*>(segments.data()), segments.size() * sizeof(KeyspaceSegmentInfo));
+        out.close();
+        if (!out) {
+            throw std::runtime_error("Failed to write keyspace file: " + path);
+        }
+        syncFile(path);
+        return entry;
+    }
+
+    // Load and validate a keyspace data file against its catalog entry.
+    // Segments are read and checksummed in parallel.
+    static std::shared_ptr<Keyspace> loadFromFile(const std::string& path, const KeyspaceCatalogEntry& entry) {
+        std::ifstream in(path, std::ios::binary | std::ios::ate);
+        if (!in) {
+            spdlog::error("Missing data file for keyspace: {}", entry.name);
+            throw std::runtime_error("Failed to open keyspace file: " + path);
+        }
+        uint64_t file_size = static_cast<uint64_t>(in.tellg());
+        in.seekg(0);
+
+        KeyspaceFileHeader header = readPod<KeyspaceFileHeader>(in);
+        uint64_t segment_count = header.segment_rows == 0 ? 0 :
+            (header.count + header.segment_rows - 1) / header.segment_rows;
+        if (header.magic != kKeyspaceFileMagic || header.version != kStorageFormatVersion ||
+            header.dimension != entry.spec.dimension || header.count != entry.count ||
+            header.last_lsn != entry.last_lsn || (header.count > 0 && header.segment_rows == 0)) {
+            spdlog::error("Keyspace file does not match catalog: {}", entry.name);
+            throw std::runtime_error("Corrupt keyspace file: " + path);
+        }
+
+        std::vector<KeyspaceSegmentInfo> segments(segment_count);
+        if (!in.read(reinterpret_cast<char*>(segments.data()), segment_count * sizeof(KeyspaceSegmentInfo))) {
+            throw std::runtime_error("Unexpected end of keyspace file: " + path);
+        }
+        std::vector<uint64_t> offsets(segment_count);
+        uint64_t end = sizeof(KeyspaceFileHeader) + segment_count * sizeof(KeyspaceSegmentInfo);
+        for (size_t segment = 0; segment < segment_count; ++segment) {
+            offsets[segment] = end;
+            end += segments[segment].stored_bytes;
+        }
+        if (file_size != end) {
+            spdlog::error("Keyspace file does not match catalog: {}", entry.name);
+            throw std::runtime_error("Corrupt keyspace file: " + path);
+        }
+
+        std::vector<double> values(header.count * header.dimension);
+        parallelFor(segment_count, [&](size_t segment) {
+            uint64_t first_row = segment * header.segment_rows;
+            uint64_t rows = std::min(header.segment_rows, header.count - first_row);
+            const KeyspaceSegmentInfo& info = segments[segment];
+            std::string stored(info.stored_bytes, '\0');
+            std::ifstream segment_in(path, std::ios::binary);
+            segment_in.seekg(offsets[segment]);
+            if (!segment_in.read(&stored[0], stored.size())) {
+                throw std::runtime_error("Unexpected end of keyspace file: " + path);
+            }
+            if (crc32c(stored.data(), stored.size()) != info.checksum) {
+                spdlog::error("Checksum mismatch in segment {} of keyspace: {}", segment, entry.name);
+                throw std::runtime_error("Corrupt keyspace file: " + path);
+            }
+            decodeFloatSegment(stored.data(), stored.size(), info.codec,
+                               values.data() + first_row * header.dimension, rows * header.dimension);
+        });
+
+        auto keyspace = std::make_shared<Keyspace>(entry.spec, entry.name);
+        keyspace->prewarm_priority = entry.prewarm_priority;
+        keyspace->last_lsn = header.last_lsn;
+        keyspace->change_sequence = entry.last_sequence;
+        KeyspaceDataBuilder builder(*keyspace->data, header.dimension);
+        for (uint64_t i = 0; i < header.count; ++i) {
+            builder.append(values.data() + i * header.dimension);
+        }
+        keyspace->publish(builder.build());
+        return keyspace;
+    }
+
+    // Stream the current version to `path` as a backup or for offline tools.
+    // Writers are not blocked while the export runs.
+    ExportStats exportToFile(const std::string& path, const ExportOptions& options = {}) const {
+        KeyspaceSnapshot pinned = snapshot();
+        ExportStats stats = exportKeyspaceData(pinned.getData(), spec, keyspace_name, path, options);
+        spdlog::info("Exported keyspace: {} ({} vectors, {} bytes) to {}",
+                     keyspace_name, stats.rows, stats.written_bytes, path);
+        return stats;
+    }
+
+    // Rebuild a keyspace from a binary export
+    static std::shared_ptr<Keyspace> importFromFile(const std::string& path) {
+        ExportReader reader(path);
+        const ExportHeader& header = reader.getHeader();
+        auto keyspace = std::make_shared<Keyspace>(header.spec, header.name);
+        KeyspaceDataBuilder builder(*keyspace->data, header.spec.dimension);
+        size_t dim = header.spec.dimension;
+        std::vector<double> chunk(std::max<size_t>(1, (1 << 20) / (dim * sizeof(double))) * dim);
+        while (size_t rows = reader.readRows(chunk.data(), chunk.size() / dim)) {
+            for (size_t r = 0; r < rows; ++r) {
+                builder.append(chunk.data() + r * dim);
+            }
+        }
+        reader.finish();
+        keyspace->publish(builder.build());
+        return keyspace;
+    }
+
     // Calculate Euclidean distance between two vectors
     double euclideanDistance(const Vector& vec1, const Vector& vec2) const {
         if (vec1.getDimension() != vec2.getDimension()) {
@@ -117,6 +1175,21 @@ public:
         return dotProduct / magnitude;
     }
 
+    double innerProduct(const Vector& vec1, const Vector& vec2) const {
+        if (vec1.getDimension() != vec2.getDimension()) {
+            throw std::runtime_error("Vectors must have same dimension");
+        }
+        if (vec1.getDimension() != dimension) {
+            throw std::runtime_error("Vector dimension does not match keyspace dimension");
+        }
+
+        double dotProduct = 0.0;
+        for (size_t i = 0; i < dimension; ++i) {
+            dotProduct += vec1[i] * vec2[i];
+        }
+        return dotProduct;
+    }
+
     double manhattanDistance(const Vector& vec1, const Vector& vec2) const {
         if (vec1.getDimension() != vec2.getDimension()) {
             throw std::runtime_error("Vectors must have same dimension");
@@ -134,156 +1207,1071 @@ public:
 
     // Add a vector to the store
     void addVector(const Vector& vec) {
-        mtx.lock();
+        std::unique_lock<std::mutex> lock(mtx);
         if (vec.getDimension() != dimension) {
             throw std::runtime_error("Vector dimension does not match store dimension");
         }
-        vectors.push_back(vec);
-        mtx.unlock();
+        // Traced under the lock so the trace holds writes in the order they apply
+        if (auto binding = std::atomic_load(&trace)) {
+            binding->recorder->recordInsert(binding->keyspace_id, vec.getData(), vec.getDimension());
+        }
+        std::vector<double> buffer;
+        const double* values = storedForm(vec, buffer);
+        WalRecord record = WalRecord::addVector(keyspace_name, values, dimension);
+        record.index = data->count;
+        uint64_t lsn = logChange(record);
+        KeyspaceDataBuilder builder(*data, dimension);
+        builder.append(values);
+        publish(builder.build());
+        requestGraphUpdate(data->version);
+        emitChange(ChangeType::Insert, record.index, values);
+        stats.add(KeyspaceCounter::Inserts);
+        commitChange(lock, lsn);
     }
 
+    // Add all vectors or, if any of them is invalid, none
     void batchAddVectors(const std::vector<Vector>& vectors){
-        mtx.lock();
+        WriteBatch batch;
         for(const Vector& vec : vectors){
-            if(vec.getDimension() != dimension){
-                throw std::runtime_error("Vector dimension does not match store dimension");
+            batch.insert(vec);
+        }
+        applyBatch(batch);
+    }
+
+    // Apply every operation of `batch` or none of them. The batch is validated
+    // before anything is logged, written to the WAL as a single record and
+    // published as a single new version, all under one lock acquisition.
+    void applyBatch(const WriteBatch& batch) {
+        if (batch.empty()) {
+            return;
+        }
+        std::unique_lock<std::mutex> lock(mtx);
+        std::vector<WalBatchEntry> entries;
+        std::vector<double> values;
+        entries.reserve(batch.size());
+        std::vector<double> buffer;
+        size_t count = data->count;
+        for (const WriteBatch::Operation& op : batch.operations()) {
+            if (op.type != WriteBatch::OpType::Remove) {
+                if (op.values.size() != dimension) {
+                    throw std::runtime_error("Vector dimension does not match store dimension");
+                }
+                const double* row = storedForm(op.values.data(), buffer);
+                values.insert(values.end(), row, row + dimension);
+            }
+            switch (op.type) {
+                case WriteBatch::OpType::Insert:
+                    entries.push_back({WalOp::AddVector, count++});
+                    break;
+                case WriteBatch::OpType::Remove:
+                    if (op.index >= count) {
+                        throw std::out_of_range("Index out of bounds");
+                    }
+                    entries.push_back({WalOp::RemoveVector, op.index});
+                    --count;
+                    break;
+                case WriteBatch::OpType::Upsert:
+                    if (op.index < count) {
+                        entries.push_back({WalOp::UpdateVector, op.index});
+                    } else {
+                        entries.push_back({WalOp::AddVector, count++});
+                    }
+                    break;
+            }
+        }
+        if (auto binding = std::atomic_load(&trace)) {
+            for (const WriteBatch::Operation& op : batch.operations()) {
+                if (op.type == WriteBatch::OpType::Insert) {
+                    binding->recorder->recordInsert(binding->keyspace_id, op.values.data(), op.values.size());
+                } else if (op.type == WriteBatch::OpType::Remove) {
+                    binding->recorder->recordRemove(binding->keyspace_id, op.index);
+                } else {
+                    binding->recorder->recordUpdate(binding->keyspace_id, TraceEventType::Upsert, op.index,
+                                                    op.values.data(), op.values.size());
+                }
             }
-            this->vectors.push_back(vec);
         }
-        mtx.unlock();
+
+        auto profiler = std::atomic_load(&perf);
+        PerfScope counters(profiler.get(), PerfQueryClass::Build);
+        KeyspaceDataBuilder builder(*data, dimension);
+        std::vector<uint64_t> rows = applyEntries(builder, entries, values);
+        WalRecord record = WalRecord::writeBatch(keyspace_name, std::move(entries), std::move(values));
+        uint64_t lsn = logChange(record);
+        publish(builder.build());
+        requestGraphUpdate(data->version);
+        emitChanges(record.sequence, record.entries, rows, record.values);
+        stats.add(KeyspaceCounter::WriteBatches);
+        for (const WalBatchEntry& entry : record.entries) {
+            stats.add(entry.op == WalOp::AddVector ? KeyspaceCounter::Inserts :
+                      entry.op == WalOp::RemoveVector ? KeyspaceCounter::Removes : KeyspaceCounter::Updates);
+        }
+        commitChange(lock, lsn);
     }
 
     // Remove a vector by index
     void removeVector(size_t index) {
-        mtx.lock();
-        if (index >= vectors.size()) {
+        std::unique_lock<std::mutex> lock(mtx);
+        if (index >= data->count) {
             throw std::out_of_range("Index out of bounds");
         }
-        vectors.erase(vectors.begin() + index);
-        mtx.unlock();
+        if (auto binding = std::atomic_load(&trace)) {
+            binding->recorder->recordRemove(binding->keyspace_id, index);
+        }
+        WalRecord record = WalRecord::removeVector(keyspace_name, index);
+        uint64_t lsn = logChange(record);
+        KeyspaceDataBuilder builder(*data, dimension);
+        builder.remove(index);
+        publish(builder.build());
+        requestGraphUpdate(data->version);
+        emitChange(ChangeType::Delete, index, nullptr);
+        stats.add(KeyspaceCounter::Removes);
+        commitChange(lock, lsn);
     }
-    
-    // Get vector by index
-    const Vector& getVector(size_t index) const {
-        if (index >= vectors.size()) {
-            throw std::runtime_error("Vector index out of range");
+
+    // Replace the vector at `index` in place
+    void updateVector(size_t index, const Vector& vec) {
+        std::unique_lock<std::mutex> lock(mtx);
+        if (vec.getDimension() != dimension) {
+            throw std::runtime_error("Vector dimension does not match store dimension");
+        }
+        if (index >= data->count) {
+            throw std::out_of_range("Index out of bounds");
+        }
+        if (auto binding = std::atomic_load(&trace)) {
+            binding->recorder->recordUpdate(binding->keyspace_id, TraceEventType::Update, index,
+                                            vec.getData(), vec.getDimension());
         }
-        return vectors[index];
+        std::vector<double> buffer;
+        const double* values = storedForm(vec, buffer);
+        WalRecord record = WalRecord::updateVector(keyspace_name, index, values, dimension);
+        uint64_t lsn = logChange(record);
+        KeyspaceDataBuilder builder(*data, dimension);
+        builder.update(index, values);
+        publish(builder.build());
+        requestGraphUpdate(data->version);
+        emitChange(ChangeType::Update, index, values);
+        stats.add(KeyspaceCounter::Updates);
+        commitChange(lock, lsn);
+    }
+    
+    // Pin the current version for consistent reads while writes continue
+    KeyspaceSnapshot snapshot() const {
+        auto current = currentData();
+        return KeyspaceSnapshot(current, spec, kernels, graphFor(current));
     }
 
-    // Find nearest neighbor
-    size_t findNearestNeighbor(const Vector& query) const {
-        if (vectors.empty()) {
-            throw std::runtime_error("Vector store is empty");
+    // Bring the graph of a Graph keyspace up to the current version on the
+    // calling thread, rather than leaving it to the background builder
+    void buildGraphIndex() const {
+        if (spec.index != IndexType::Graph) {
+            throw std::runtime_error("Keyspace has no graph index: " + keyspace_name);
         }
+        updateGraph(currentData());
+    }
 
-        size_t nearest_idx = 0;
-        double min_distance = euclideanDistance(query, vectors[0]);
+    // Copy of the vector at `index`
+    Vector getVector(size_t index) const {
+        return snapshot().getVector(index);
+    }
 
-        for (size_t i = 1; i < vectors.size(); ++i) {
-            double dist = euclideanDistance(query, vectors[i]);
-            if (dist < min_distance) {
-                min_distance = dist;
-                nearest_idx = i;
-            }
+    // Copy-on-write clone: the new keyspace shares every page with this one
+    // and pages are copied only when either side modifies them afterwards.
+    std::shared_ptr<Keyspace> clone(const std::string& name) const {
+        std::unique_lock<std::mutex> lock(mtx);
+        auto copy = std::make_shared<Keyspace>(spec, name);
+        copy->data = data;
+        copy->graph = std::atomic_load(&graph);  // built from history both keyspaces share
+        copy->prewarm_priority = prewarm_priority;
+        if (wal) {
+            // Logged under this keyspace's lock so replay clones exactly this version
+            WalRecord record = WalRecord::cloneKeyspace(name, keyspace_name);
+            copy->last_lsn = wal->write(record);
+            copy->wal = wal;
         }
+        commitChange(lock, copy->last_lsn);
+        return copy;
+    }
+
+    // Find nearest neighbor under the keyspace's distance metric. Pass
+    // `profile` to get an explain of the search alongside the result.
+    size_t findNearestNeighbor(const Vector& query, SearchProfile* profile = nullptr) const {
+        return searchNearest(query, nullptr, profile);
+    }
 
-        return nearest_idx;
+    // Nearest neighbor with each dimension's term scaled by `weights`, or only
+    // the kept dimensions of a mask. Always an exact scan, even with a graph.
+    size_t findNearestNeighbor(const Vector& query, const DimensionWeights& weights,
+                               SearchProfile* profile = nullptr) const {
+        return searchNearest(query, &weights, profile);
     }
 
     // Find all neighbors above similarity threshold
     std::vector<std::pair<size_t, double>> findNeighborsAboveThreshold(
         const Vector& query,
-        double threshold
+        double threshold,
+        SearchProfile* profile = nullptr
     ) const {
-        if (vectors.empty()) {
-            throw std::runtime_error("Vector store is empty");
-        }
-
         std::vector<std::pair<size_t, double>> results;
-        
-        for (size_t i = 0; i < vectors.size(); ++i) {
-            double dist = euclideanDistance(query, vectors[i]);
-            // Convert euclideanDistance to similarity (1 / (1 + euclideanDistance))
-            double similarity = 1.0 / (1.0 + dist);
-            
-            if (similarity >= threshold) {
-                results.emplace_back(i, similarity);
-            }
-        }
+        searchAboveThreshold(query, threshold, nullptr, results, profile);
+        return results;
+    }
 
-        // Sort results by similarity in descending order
-        std::sort(results.begin(), results.end(),
-            [](const auto& a, const auto& b) {
-                return a.second > b.second;
-            }
-        );
+    // Same, into `results`; reuse one vector across searches to avoid allocating
+    void findNeighborsAboveThreshold(const Vector& query, double threshold,
+                                     std::vector<std::pair<size_t, double>>& results,
+                                     SearchProfile* profile = nullptr) const {
+        searchAboveThreshold(query, threshold, nullptr, results, profile);
+    }
 
+    // Threshold searches with similarities computed under `weights`
+    std::vector<std::pair<size_t, double>> findNeighborsAboveThreshold(const Vector& query, double threshold,
+                                                                       const DimensionWeights& weights,
+                                                                       SearchProfile* profile = nullptr) const {
+        std::vector<std::pair<size_t, double>> results;
+        searchAboveThreshold(query, threshold, &weights, results, profile);
         return results;
     }
+
+    void findNeighborsAboveThreshold(const Vector& query, double threshold, const DimensionWeights& weights,
+                                     std::vector<std::pair<size_t, double>>& results,
+                                     SearchProfile* profile = nullptr) const {
+        searchAboveThreshold(query, threshold, &weights, results, profile);
+    }
 };
 
 class VectorStore {
 private:
-    std::vector<std::shared_ptr<Keyspace>> keyspaces;
-    std::mutex mtx;
+    // A keyspace known from the catalog whose data file has not been read yet
+    struct PendingKeyspace {
+        KeyspaceCatalogEntry entry;
+        std::string path;
+        std::once_flag load_once;
+        std::shared_ptr<Keyspace> keyspace;
+    };
+
+    // Both maps are lazily filled caches, so lookups through a const store may update them
+    mutable std::unordered_map<std::string, std::shared_ptr<Keyspace>> keyspaces;
+    mutable std::unordered_map<std::string, std::shared_ptr<PendingKeyspace>> pending_keyspaces;
+    mutable std::mutex mtx;
     std::string vector_store_name;
+    std::string data_directory;
+    SegmentCodec segment_codec = SegmentCodec::ShuffleHuffman;  // for data files written by save()
+
+    // Alias name -> target keyspace. The table is immutable once published: it is
+    // replaced wholesale under `mtx` and read with std::atomic_load, so routing
+    // through an alias never waits on the store lock.
+    struct AliasTarget {
+        std::string keyspace;
+        std::shared_ptr<Keyspace> resolved;  // null until the target has been loaded
+    };
+    using AliasTable = std::unordered_map<std::string, AliasTarget>;
+    mutable std::shared_ptr<const AliasTable> aliases = std::make_shared<AliasTable>();
+    std::shared_ptr<WriteAheadLog> wal;
+    std::thread prewarm_thread;
+    std::atomic<bool> stop_prewarm{false};
+    std::shared_ptr<TraceRecorder> trace_recorder;  // set while a workload trace is recorded
+    std::shared_ptr<PerfProfiler> perf_profiler;    // set while hardware counters are sampled
+    std::shared_ptr<SlowQueryLog> slow_query_log;   // set while slow queries are logged
+    // Set while store-level searches export spans; read with std::atomic_load
+    std::shared_ptr<SpanExporter> span_exporter;
+
+    // Attach the active trace and counters to `keyspace`. Must hold `mtx`.
+    void bindInstrumentation(const std::shared_ptr<Keyspace>& keyspace) const {
+        if (trace_recorder) {
+            keyspace->setTraceRecorder(trace_recorder);
+        }
+        if (perf_profiler) {
+            keyspace->setPerfProfiler(perf_profiler);
+        }
+        if (slow_query_log) {
+            keyspace->setSlowQueryLog(slow_query_log);
+        }
+    }
+
+    // Read a pending keyspace from disk exactly once and move it into the loaded set
+    std::shared_ptr<Keyspace> loadPendingKeyspace(const std::shared_ptr<PendingKeyspace>& slot) const {
+        std::call_once(slot->load_once, [&]() {
+            slot->keyspace = Keyspace::loadFromFile(slot->path, slot->entry);
+            if (wal) {
+                slot->keyspace->attachWriteAheadLog(wal, false);
+            }
+            spdlog::info("Loaded keyspace: {} ({} vectors) into VectorStore: {}",
+                         slot->entry.name, slot->entry.count, vector_store_name);
+        });
+
+        std::lock_guard<std::mutex> lock(mtx);
+        auto it = pending_keyspaces.find(slot->entry.name);
+        if (it != pending_keyspaces.end() && it->second == slot) {
+            pending_keyspaces.erase(it);
+            keyspaces.emplace(slot->entry.name, slot->keyspace);
+            bindInstrumentation(slot->keyspace);
+        }
+        return slot->keyspace;
+    }
+
+    // Replay the WAL records of one keyspace, in log order, on top of its snapshot
+    void replayKeyspaceRecords(const std::vector<const WalRecord*>& records) {
+        const std::string& name = records.front()->keyspace;
+        std::shared_ptr<Keyspace> keyspace;
+        std::shared_ptr<PendingKeyspace> slot;
+        uint64_t snapshot_lsn = 0;
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            auto it = pending_keyspaces.find(name);
+            if (it != pending_keyspaces.end()) {
+                slot = it->second;
+            }
+            auto loaded_it = keyspaces.find(name);
+            if (loaded_it != keyspaces.end()) {
+                keyspace = loaded_it->second;
+            }
+        }
+        if (slot) {
+            keyspace = loadPendingKeyspace(slot);
+        }
+        if (keyspace) {
+            snapshot_lsn = keyspace->getLastLsn();
+        }
+
+        size_t applied = 0;
+        for (const WalRecord* record : records) {
+            if (record->lsn <= snapshot_lsn) {
+                if (keyspace) {
+                    keyspace->indexRecoveredChanges(*record);
+                }
+                continue;  // already contained in the snapshot
+            }
+            if (record->op == WalOp::CreateKeyspace) {
+                keyspace = std::make_shared<Keyspace>(record->spec, name);
+                keyspace->applyWalRecord(*record);
+                std::lock_guard<std::mutex> lock(mtx);
+                keyspaces[name] = keyspace;
+                pending_keyspaces.erase(name);
+            } else if (record->op == WalOp::DropKeyspace) {
+                keyspace.reset();
+                std::lock_guard<std::mutex> lock(mtx);
+                keyspaces.erase(name);
+                pending_keyspaces.erase(name);
+            } else if (!keyspace) {
+                spdlog::error("WAL record {} refers to missing keyspace: {}", record->lsn, name);
+                continue;
+            } else {
+                try {
+                    keyspace->applyWalRecord(*record);
+                } catch (const std::exception& e) {
+                    spdlog::error("Failed to replay WAL record {} for keyspace {}: {}", record->lsn, name, e.what());
+                    continue;
+                }
+            }
+            ++applied;
+        }
+        spdlog::info("Replayed {} WAL records for keyspace: {}", applied, name);
+    }
+
+    // Replay a clone record; it reads one keyspace and writes another, so it
+    // runs on its own between the parallel phases
+    void replayClone(const WalRecord& record) {
+        std::shared_ptr<Keyspace> existing;
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            auto it = keyspaces.find(record.keyspace);
+            if (it != keyspaces.end()) {
+                existing = it->second;
+            }
+            auto pending_it = pending_keyspaces.find(record.keyspace);
+            if (pending_it != pending_keyspaces.end() && pending_it->second->entry.last_lsn >= record.lsn) {
+                return;  // the clone is already part of the snapshot
+            }
+        }
+        if (existing && existing->getLastLsn() >= record.lsn) {
+            return;
+        }
+        std::shared_ptr<Keyspace> source;
+        try {
+            source = getKeyspace(record.source);
+        } catch (const std::exception& e) {
+            spdlog::error("WAL record {} clones missing keyspace: {}", record.lsn, record.source);
+            return;
+        }
+        auto clone = source->clone(record.keyspace);
+        clone->applyWalRecord(record);
+        std::lock_guard<std::mutex> lock(mtx);
+        keyspaces[record.keyspace] = clone;
+        pending_keyspaces.erase(record.keyspace);
+    }
+
+    // Bring the store up to date with the WAL, then start logging to a fresh segment.
+    // Records are partitioned by keyspace and the partitions replayed in parallel;
+    // records spanning two keyspaces (clones) act as barriers between phases.
+    void recoverFromWriteAheadLog() {
+        std::vector<WalRecord> records = WriteAheadLog::readAll(data_directory);
+
+        uint64_t max_lsn = 0;
+        for (const auto& [name, slot] : pending_keyspaces) {
+            max_lsn = std::max(max_lsn, slot->entry.last_lsn);
+        }
+
+        std::unordered_map<std::string, size_t> partition_of;
+        std::vector<std::vector<const WalRecord*>> partitions;
+        auto replayPartitions = [&]() {
+            parallelFor(partitions.size(), [&](size_t p) {
+                replayKeyspaceRecords(partitions[p]);
+            });
+            partition_of.clear();
+            partitions.clear();
+        };
+        std::unordered_map<std::string, bool> touched;
+        for (const WalRecord& record : records) {
+            max_lsn = std::max(max_lsn, record.lsn);
+            touched[record.keyspace] = true;
+            if (record.op == WalOp::CloneKeyspace) {
+                replayPartitions();
+                replayClone(record);
+                continue;
+            }
+            if (record.op == WalOp::SetAlias || record.op == WalOp::RemoveAlias) {
+                replayPartitions();
+                replayAlias(record);
+                continue;
+            }
+            auto it = partition_of.emplace(record.keyspace, partitions.size()).first;
+            if (it->second == partitions.size()) {
+                partitions.emplace_back();
+            }
+            partitions[it->second].push_back(&record);
+        }
+        replayPartitions();
+        // Keyspaces replaced during replay must be what their aliases route to
+        for (const auto& [name, keyspace] : keyspaces) {
+            refreshAliases(name, keyspace);
+        }
+        if (!records.empty()) {
+            spdlog::info("Recovered {} WAL records across {} keyspaces in VectorStore: {}",
+                         records.size(), touched.size(), vector_store_name);
+        }
+
+        auto segments = WriteAheadLog::listSegments(data_directory);
+        uint64_t next_segment = segments.empty() ? 1 : segments.back() + 1;
+        wal = std::make_shared<WriteAheadLog>(data_directory, next_segment, max_lsn + 1);
+        for (const auto& [name, keyspace] : keyspaces) {
+            keyspace->attachWriteAheadLog(wal, false);
+        }
+    }
+
+    // Must hold `mtx`
+    void publishAliases(AliasTable table) const {
+        std::atomic_store(&aliases, std::shared_ptr<const AliasTable>(std::make_shared<AliasTable>(std::move(table))));
+    }
+
+    // Must hold `mtx`
+    bool nameInUse(const std::string& name) const {
+        return keyspaces.count(name) > 0 || pending_keyspaces.count(name) > 0 || aliases->count(name) > 0;
+    }
+
+    // Point aliases of `name` at a keyspace object that replaced it. Must hold `mtx`.
+    void refreshAliases(const std::string& name, const std::shared_ptr<Keyspace>& keyspace) {
+        AliasTable table = *aliases;
+        bool changed = false;
+        for (auto& [alias, target] : table) {
+            if (target.keyspace == name) {
+                target.resolved = keyspace;
+                changed = true;
+            }
+        }
+        if (changed) {
+            publishAliases(std::move(table));
+        }
+    }
+
+    // Run `search(keyspace, profile)` on the keyspace or alias `name`. While
+    // span export is on, the search is profiled and its stages are emitted as
+    // spans under one root: route (alias resolution, waiting on the store lock
+    // and any lazy load), plan, index.scan and, for threshold searches, rerank.
+    template <typename Search>
+    auto routeSearch(const std::string& name, const char* operation, SearchProfile* profile,
+                     Search&& search) const {
+        using Clock = std::chrono::steady_clock;
+        auto exporter = std::atomic_load(&span_exporter);
+        if (!exporter) {
+            return search(*getKeyspace(name), profile);
+        }
+        SearchProfile local;
+        if (!profile) {
+            profile = &local;
+        }
+        auto start = Clock::now();
+        auto keyspace = getKeyspace(name);
+        auto routed = Clock::now();
+        auto result = search(*keyspace, profile);
+        auto end = Clock::now();
+
+        auto after = [](Clock::time_point t, double us) {
+            return t + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double, std::micro>(us));
+        };
+        SpanBuilder spans;
+        uint64_t root = spans.add("vector_store.search", 0, start, end, {
+            SpanAttribute::text("vector_store.name", vector_store_name),
+            SpanAttribute::text("keyspace", name),
+            SpanAttribute::text("operation", operation),
+            SpanAttribute::integer("rows", static_cast<int64_t>(profile->rows)),
+            SpanAttribute::integer("results", static_cast<int64_t>(profile->results)),
+        });
+        spans.add("route", root, start, routed, {SpanAttribute::text("keyspace.resolved", keyspace->getName())});
+        auto plan_end = after(profile->started_at, profile->prepare_us);
+        spans.add("plan", root, profile->started_at, plan_end, {SpanAttribute::text("plan", profile->plan)});
+        auto scan_end = after(plan_end, profile->scan_us);
+        spans.add("index.scan", root, plan_end, scan_end, {
+            SpanAttribute::integer("pages_visited", static_cast<int64_t>(profile->pages_visited)),
+            SpanAttribute::integer("distance_evaluations", static_cast<int64_t>(profile->distance_evaluations)),
+            SpanAttribute::integer("bytes_read", static_cast<int64_t>(profile->bytes_read)),
+        });
+        if (profile->sort_us > 0) {
+            spans.add("rerank", root, scan_end, after(scan_end, profile->sort_us), {
+                SpanAttribute::integer("candidates_filtered", static_cast<int64_t>(profile->candidates_filtered)),
+            });
+        }
+        exporter->submit(spans.take());
+        return result;
+    }
+
+    // First lookup through an alias whose target is still on disk
+    std::shared_ptr<Keyspace> resolveAlias(const std::string& alias, const std::string& target) const {
+        auto keyspace = getKeyspace(target);
+        std::lock_guard<std::mutex> lock(mtx);
+        auto it = aliases->find(alias);
+        if (it != aliases->end() && it->second.keyspace == target && !it->second.resolved) {
+            AliasTable table = *aliases;
+            table[alias].resolved = keyspace;
+            publishAliases(std::move(table));
+        }
+        return keyspace;
+    }
+
+    void replayAlias(const WalRecord& record) {
+        std::lock_guard<std::mutex> lock(mtx);
+        AliasTable table = *aliases;
+        if (record.op == WalOp::SetAlias) {
+            auto it = keyspaces.find(record.source);
+            table[record.keyspace] = {record.source, it != keyspaces.end() ? it->second : nullptr};
+        } else {
+            table.erase(record.keyspace);
+        }
+        publishAliases(std::move(table));
+    }
+
+    void stopPrewarm() {
+        stop_prewarm = true;
+        if (prewarm_thread.joinable()) {
+            prewarm_thread.join();
+        }
+        stop_prewarm = false;
+    }
+
 public:
     VectorStore(std::string name) : vector_store_name(name) {
         spdlog::info("Initializing VectorStore: {}", name);
     }
 
+    // Open (or create) a durable store in `directory`. Only the catalog is read
+    // here; keyspace data is loaded on first getKeyspace() or by startPrewarm(),
+    // except for keyspaces that have WAL records to replay after a crash.
+    // Every mutation is logged to the WAL until the next save() checkpoint.
+    VectorStore(std::string name, const std::string& directory)
+        : vector_store_name(name), data_directory(directory) {
+        spdlog::info("Initializing VectorStore: {} from {}", name, directory);
+        std::filesystem::path dir(directory);
+        std::filesystem::create_directories(dir);
+        if (std::filesystem::exists(dir / kCatalogFileName)) {
+            StoreCatalog catalog = readCatalog((dir / kCatalogFileName).string());
+            for (auto& entry : catalog.keyspaces) {
+                auto slot = std::make_shared<PendingKeyspace>();
+                slot->path = (dir / keyspaceFileName(entry.name, entry.generation)).string();
+                slot->entry = std::move(entry);
+                pending_keyspaces.emplace(slot->entry.name, slot);
+            }
+            AliasTable table;
+            for (auto& [alias, target] : catalog.aliases) {
+                table[alias] = {target, nullptr};
+            }
+            publishAliases(std::move(table));
+        }
+        spdlog::info("Found {} keyspaces in catalog of VectorStore: {}", pending_keyspaces.size(), name);
+        recoverFromWriteAheadLog();
+    }
+
+    ~VectorStore() {
+        stopPrewarm();
+    }
+
+    // Pick the fastest scan variant per kernel and dimension class on this
+    // CPU, reusing the choices cached at `cache_path` when they were measured
+    // on the same CPU. Applies to keyspaces created or loaded afterwards, so
+    // call it at startup before opening stores.
+    static void calibrateKernels(const std::string& cache_path, bool force = false) {
+        calibrateSearchKernels(cache_path, force);
+    }
+
+    // How far ahead searches prefetch: rows across page boundaries in scans,
+    // and neighbor vectors in graph traversals. 0 disables either.
+    static void setPrefetchDistances(size_t scan_rows, size_t graph_neighbors) {
+        ::setPrefetchDistances(scan_rows, graph_neighbors);
+    }
+
     void addKeyspace(const std::shared_ptr<Keyspace>& keyspace) {
-        mtx.lock();
-        keyspaces.push_back(keyspace);
+        std::lock_guard<std::mutex> lock(mtx);
+        if (wal) {
+            keyspace->attachWriteAheadLog(wal, true);
+        }
+        keyspaces[keyspace->getName()] = keyspace;
+        pending_keyspaces.erase(keyspace->getName());
+        bindInstrumentation(keyspace);
+        refreshAliases(keyspace->getName(), keyspace);
         spdlog::info("Added keyspace: {}", keyspace->getName());
-        mtx.unlock();
     }
 
     void removeKeyspace(const std::string& name) {
-        mtx.lock();
-        keyspaces.erase(
-            std::remove_if(keyspaces.begin(), keyspaces.end(),
-                [&](const std::shared_ptr<Keyspace>& k) { 
-                    return k->getName() == name; 
-                }
-            ),
-            keyspaces.end()
-        );
+        std::lock_guard<std::mutex> lock(mtx);
+        auto it = keyspaces.find(name);
+        if (it != keyspaces.end()) {
+            it->second->attachWriteAheadLog(nullptr, false);
+            it->second->setTraceRecorder(nullptr);
+            it->second->setPerfProfiler(nullptr);
+            it->second->setSlowQueryLog(nullptr);
+            keyspaces.erase(it);
+        }
+        pending_keyspaces.erase(name);
+
+        // Aliases never dangle: drop the ones routing to this keyspace
+        AliasTable table = *aliases;
+        for (auto alias_it = table.begin(); alias_it != table.end();) {
+            if (alias_it->second.keyspace != name) {
+                ++alias_it;
+                continue;
+            }
+            spdlog::warn("Removing alias: {} of removed keyspace: {}", alias_it->first, name);
+            if (wal) {
+                WalRecord record = WalRecord::removeAlias(alias_it->first);
+                wal->append(record);
+            }
+            alias_it = table.erase(alias_it);
+        }
+        publishAliases(std::move(table));
+
+        if (wal) {
+            WalRecord record = WalRecord::dropKeyspace(name);
+            wal->append(record);
+        }
         spdlog::info("Removed keyspace: {}, from VectorStore: {}", name, vector_store_name);
-        mtx.unlock();
     }
 
+    // Look up a keyspace by name or alias
     std::shared_ptr<Keyspace> getKeyspace(const std::string& name) const {
-        for(const auto& keyspace: keyspaces) {
-            if(keyspace->getName() == name) {
-                return keyspace;
+        {
+            auto table = std::atomic_load(&aliases);
+            auto it = table->find(name);
+            if (it != table->end()) {
+                if (it->second.resolved) {
+                    return it->second.resolved;
+                }
+                return resolveAlias(name, it->second.keyspace);
+            }
+        }
+
+        std::shared_ptr<PendingKeyspace> slot;
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            auto it = keyspaces.find(name);
+            if (it != keyspaces.end()) {
+                return it->second;
             }
+            auto pending_it = pending_keyspaces.find(name);
+            if (pending_it != pending_keyspaces.end()) {
+                slot = pending_it->second;
+            }
+        }
+        if (slot) {
+            return loadPendingKeyspace(slot);
         }
         spdlog::error("Keyspace not found: {} in VectorStore: {}", name, vector_store_name);
         throw std::runtime_error("Keyspace not found");
     }
 
     std::shared_ptr<Keyspace> createKeyspace(size_t dimension, const std::string& name) {
-        mtx.lock();
+        return createKeyspace(KeyspaceSpec(dimension), name);
+    }
+
+    // Create a keyspace whose element type, metric, normalization, index and
+    // storage tier are fixed by `spec`
+    std::shared_ptr<Keyspace> createKeyspace(const KeyspaceSpec& spec, const std::string& name) {
+        spec.validate();
+        std::lock_guard<std::mutex> lock(mtx);
         
-        // Check if keyspace with same name already exists
-        for(const auto& keyspace: keyspaces) {
-            if(keyspace->getName() == name) {
-                mtx.unlock();
-                spdlog::error("Keyspace with name '{}' already exists in VectorStore: {}", name, vector_store_name);
-                throw std::runtime_error("Keyspace with this name already exists");
-            }
+        // Check if keyspace or alias with same name already exists
+        if (nameInUse(name)) {
+            spdlog::error("Keyspace with name '{}' already exists in VectorStore: {}", name, vector_store_name);
+            throw std::runtime_error("Keyspace with this name already exists");
         }
         
         // Create new keyspace
-        auto new_keyspace = std::make_shared<Keyspace>(dimension, name);
-        keyspaces.push_back(new_keyspace);
+        auto new_keyspace = std::make_shared<Keyspace>(spec, name);
+        if (wal) {
+            new_keyspace->attachWriteAheadLog(wal, true);
+        }
+        keyspaces.emplace(name, new_keyspace);
+        bindInstrumentation(new_keyspace);
         spdlog::info("Created and added keyspace: {} to VectorStore: {}", name, vector_store_name);
-        
-        mtx.unlock();
         return new_keyspace;
     }
+
+    // Create `destination` as a copy-on-write clone of `source`. The clone is
+    // instant: both keyspaces share pages until one of them modifies a page.
+    std::shared_ptr<Keyspace> cloneKeyspace(const std::string& source, const std::string& destination) {
+        auto source_keyspace = getKeyspace(source);
+        std::lock_guard<std::mutex> lock(mtx);
+        if (nameInUse(destination)) {
+            spdlog::error("Keyspace with name '{}' already exists in VectorStore: {}", destination, vector_store_name);
+            throw std::runtime_error("Keyspace with this name already exists");
+        }
+        auto clone = source_keyspace->clone(destination);
+        keyspaces.emplace(destination, clone);
+        bindInstrumentation(clone);
+        spdlog::info("Cloned keyspace: {} into {} in VectorStore: {}", source, destination, vector_store_name);
+        return clone;
+    }
+
+    // Create or atomically re-point `alias` at keyspace `target`. Readers routing
+    // through the alias see either the old or the new keyspace, never a gap.
+    void setAlias(const std::string& alias, const std::string& target) {
+        if (std::atomic_load(&aliases)->count(target) > 0) {
+            throw std::runtime_error("Alias target must be a keyspace, not an alias");
+        }
+        auto keyspace = getKeyspace(target);
+        std::lock_guard<std::mutex> lock(mtx);
+        if (keyspaces.count(alias) > 0 || pending_keyspaces.count(alias) > 0) {
+            spdlog::error("Alias '{}' collides with a keyspace in VectorStore: {}", alias, vector_store_name);
+            throw std::runtime_error("Alias name is already used by a keyspace");
+        }
+        auto it = keyspaces.find(target);
+        if (it == keyspaces.end() || it->second != keyspace) {
+            throw std::runtime_error("Keyspace was removed while setting alias");
+        }
+        if (wal && keyspace->getSpec().storage == StorageTier::Durable) {
+            WalRecord record = WalRecord::setAlias(alias, target);
+            wal->append(record);
+        }
+        AliasTable table = *aliases;
+        table[alias] = {target, keyspace};
+        publishAliases(std::move(table));
+        spdlog::info("Alias: {} now points to keyspace: {} in VectorStore: {}", alias, target, vector_store_name);
+    }
+
+    void removeAlias(const std::string& alias) {
+        std::lock_guard<std::mutex> lock(mtx);
+        if (aliases->count(alias) == 0) {
+            throw std::runtime_error("Alias not found");
+        }
+        if (wal) {
+            WalRecord record = WalRecord::removeAlias(alias);
+            wal->append(record);
+        }
+        AliasTable table = *aliases;
+        table.erase(alias);
+        publishAliases(std::move(table));
+        spdlog::info("Removed alias: {} from VectorStore: {}", alias, vector_store_name);
+    }
+
+    // Name of the keyspace `alias` currently points to
+    std::string getAliasTarget(const std::string& alias) const {
+        auto table = std::atomic_load(&aliases);
+        auto it = table->find(alias);
+        if (it == table->end()) {
+            throw std::runtime_error("Alias not found");
+        }
+        return it->second.keyspace;
+    }
+
+    // Names of all keyspaces, including ones not yet loaded from disk
+    std::vector<std::string> listKeyspaces() const {
+        std::lock_guard<std::mutex> lock(mtx);
+        std::vector<std::string> names;
+        names.reserve(keyspaces.size() + pending_keyspaces.size());
+        for (const auto& [name, keyspace] : keyspaces) {
+            names.push_back(name);
+        }
+        for (const auto& [name, slot] : pending_keyspaces) {
+            names.push_back(name);
+        }
+        std::sort(names.begin(), names.end());
+        return names;
+    }
+
+    bool isKeyspaceLoaded(const std::string& name) const {
+        std::lock_guard<std::mutex> lock(mtx);
+        return keyspaces.count(name) > 0;
+    }
+
+    // Record every operation on this store's keyspaces to a trace file at
+    // `path`, replacing any trace already being recorded
+    void startTrace(const std::string& path) {
+        auto recorder = std::make_shared<TraceRecorder>(path);
+        std::lock_guard<std::mutex> lock(mtx);
+        trace_recorder = recorder;
+        for (const auto& [name, keyspace] : keyspaces) {
+            keyspace->setTraceRecorder(recorder);
+        }
+        spdlog::info("Recording workload trace of VectorStore: {} to {}", vector_store_name, path);
+    }
+
+    // Stop recording; returns the number of events written
+    uint64_t stopTrace() {
+        std::lock_guard<std::mutex> lock(mtx);
+        if (!trace_recorder) {
+            return 0;
+        }
+        for (const auto& [name, keyspace] : keyspaces) {
+            keyspace->setTraceRecorder(nullptr);
+        }
+        trace_recorder->flush();
+        uint64_t events = trace_recorder->eventCount();
+        spdlog::info("Stopped workload trace {} after {} events", trace_recorder->getPath(), events);
+        trace_recorder.reset();
+        return events;
+    }
+
+    // Sample hardware counters around one in every `sample_every` searches
+    // and write batches per thread, replacing any profiler already active.
+    // Returns the profiler the counts accumulate in.
+    std::shared_ptr<PerfProfiler> enablePerfCounters(size_t sample_every = 1) {
+        auto profiler = std::make_shared<PerfProfiler>(sample_every);
+        if (!threadPerfCounters().isAvailable()) {
+            spdlog::warn("Hardware performance counters are not available; counts will stay empty");
+        }
+        std::lock_guard<std::mutex> lock(mtx);
+        perf_profiler = profiler;
+        for (const auto& [name, keyspace] : keyspaces) {
+            keyspace->setPerfProfiler(profiler);
+        }
+        return profiler;
+    }
+
+    void disablePerfCounters() {
+        std::lock_guard<std::mutex> lock(mtx);
+        for (const auto& [name, keyspace] : keyspaces) {
+            keyspace->setPerfProfiler(nullptr);
+        }
+        perf_profiler.reset();
+    }
+
+    // Counts per query class since counters were enabled; empty when disabled
+    std::vector<PerfClassSummary> getPerfCounters() const {
+        std::lock_guard<std::mutex> lock(mtx);
+        return perf_profiler ? perf_profiler->summaries() : std::vector<PerfClassSummary>();
+    }
+
+    // Nearest neighbor of `query` in the keyspace or alias `name`
+    size_t findNearestNeighbor(const std::string& name, const Vector& query,
+                               SearchProfile* profile = nullptr) const {
+        return routeSearch(name, "nearest", profile, [&](const Keyspace& keyspace, SearchProfile* p) {
+            return keyspace.findNearestNeighbor(query, p);
+        });
+    }
+
+    // Neighbors of `query` above `threshold` in the keyspace or alias `name`, most similar first
+    std::vector<std::pair<size_t, double>> findNeighborsAboveThreshold(const std::string& name, const Vector& query,
+                                                                       double threshold,
+                                                                       SearchProfile* profile = nullptr) const {
+        return routeSearch(name, "threshold", profile, [&](const Keyspace& keyspace, SearchProfile* p) {
+            return keyspace.findNeighborsAboveThreshold(query, threshold, p);
+        });
+    }
+
+    // Export spans of every store-level search to `path` as OTLP JSON lines,
+    // replacing any export already running
+    void startSpanExport(const std::string& path) {
+        std::atomic_store(&span_exporter, std::make_shared<SpanExporter>(path, vector_store_name));
+        spdlog::info("Exporting search spans of VectorStore: {} to {}", vector_store_name, path);
+    }
+
+    // Stop exporting and flush; returns the number of spans written
+    uint64_t stopSpanExport() {
+        auto exporter = std::atomic_exchange(&span_exporter, std::shared_ptr<SpanExporter>());
+        if (!exporter) {
+            return 0;
+        }
+        uint64_t spans = exporter->flush();
+        spdlog::info("Stopped span export to {} after {} spans", exporter->getPath(), spans);
+        return spans;
+    }
+
+    // Log every search slower than `threshold_us` microseconds, with its
+    // query vector and profile, into a ring of `capacity` entries. Replaces
+    // any log already active.
+    std::shared_ptr<SlowQueryLog> enableSlowQueryLog(double threshold_us, size_t capacity = 1024) {
+        auto log = std::make_shared<SlowQueryLog>(threshold_us, capacity);
+        std::lock_guard<std::mutex> lock(mtx);
+        slow_query_log = log;
+        for (const auto& [name, keyspace] : keyspaces) {
+            keyspace->setSlowQueryLog(log);
+        }
+        spdlog::info("Logging searches slower than {}us in VectorStore: {}", threshold_us, vector_store_name);
+        return log;
+    }
+
+    void disableSlowQueryLog() {
+        std::lock_guard<std::mutex> lock(mtx);
+        for (const auto& [name, keyspace] : keyspaces) {
+            keyspace->setSlowQueryLog(nullptr);
+        }
+        slow_query_log.reset();
+    }
+
+    // Write the slow queries currently logged to `path` (see slow_query_log.hpp
+    // for the layout); returns how many were written
+    size_t dumpSlowQueries(const std::string& path) const {
+        std::shared_ptr<SlowQueryLog> log;
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            log = slow_query_log;
+        }
+        if (!log) {
+            throw std::runtime_error("Slow query log is not enabled");
+        }
+        size_t count = log->dump(path);
+        spdlog::info("Dumped {} slow queries to {} ({} dropped)", count, path, log->droppedCount());
+        return count;
+    }
+
+    // Codec for data file segments written by later saves; files already on
+    // disk keep theirs until rewritten
+    void setSegmentCodec(SegmentCodec codec) { segment_codec = codec; }
+
+    // Whether WAL appends wait for fdatasync (the default) or only for the
+    // write to reach the OS. Flush is faster but loses the latest writes on an
+    // OS crash or power loss. No effect on stores without a data directory.
+    void setWalSyncMode(WalSyncMode mode) {
+        if (wal) {
+            wal->setSyncMode(mode);
+        }
+    }
+
+    // Checkpoint a durable store into its own directory, truncating the WAL
+    void save() {
+        if (data_directory.empty()) {
+            throw std::runtime_error("VectorStore has no data directory");
+        }
+        save(data_directory);
+    }
+
+    // Persist every keyspace and the catalog into `directory`. Saving a durable
+    // store into its own directory is a checkpoint and truncates the WAL.
+    void save(const std::string& directory) {
+        std::filesystem::path dir(directory);
+        std::filesystem::create_directories(dir);
+
+        // Records in segments closed here are all contained in the snapshot below;
+        // later records carry LSNs past each keyspace's snapshot LSN.
+        bool checkpoint = wal && std::filesystem::equivalent(dir, data_directory);
+        uint64_t closed_segment = checkpoint ? wal->rotate() : 0;
+
+        std::vector<std::shared_ptr<Keyspace>> loaded;
+        std::vector<std::shared_ptr<PendingKeyspace>> unloaded;
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            for (const auto& [name, keyspace] : keyspaces) {
+                if (keyspace->getSpec().storage == StorageTier::Durable) {
+                    loaded.push_back(keyspace);
+                }
+            }
+            for (const auto& [name, slot] : pending_keyspaces) {
+                unloaded.push_back(slot);
+            }
+        }
+
+        // Data files go under a new generation so the catalog being replaced
+        // stays valid until the new one is in place
+        StoreCatalog catalog;
+        if (std::filesystem::exists(dir / kCatalogFileName)) {
+            catalog.generation = readCatalog((dir / kCatalogFileName).string()).generation;
+        }
+        catalog.generation++;
+        std::vector<KeyspaceCatalogEntry>& entries = catalog.keyspaces;
+        for (const auto& [alias, target] : *std::atomic_load(&aliases)) {
+            if (!target.resolved || target.resolved->getSpec().storage == StorageTier::Durable) {
+                catalog.aliases.emplace_back(alias, target.keyspace);
+            }
+        }
+        for (const auto& keyspace : loaded) {
+            std::string path = (dir / keyspaceFileName(keyspace->getName(), catalog.generation)).string();
+            entries.push_back(keyspace->saveToFile(path, segment_codec));
+            entries.back().generation = catalog.generation;
+        }
+        // Keyspaces never loaded are still unchanged on disk; copy them only when saving elsewhere
+        for (const auto& slot : unloaded) {
+            KeyspaceCatalogEntry entry = slot->entry;
+            if (!std::filesystem::equivalent(std::filesystem::path(slot->path).parent_path(), dir)) {
+                std::filesystem::path target = dir / keyspaceFileName(entry.name, catalog.generation);
+                std::filesystem::copy_file(slot->path, target, std::filesystem::copy_options::overwrite_existing);
+                syncFile(target.string());
+                entry.generation = catalog.generation;
+            }
+            entries.push_back(std::move(entry));
+        }
+        writeCatalog((dir / kCatalogFileName).string(), catalog);
+        // Only now that the new catalog is durable are the closed WAL segments redundant
+        if (checkpoint) {
+            wal->removeSegmentsUpTo(closed_segment);
+            for (const auto& keyspace : loaded) {
+                keyspace->forgetLoggedChanges(closed_segment);
+            }
+        }
+
+        // Drop data files of earlier saves and of keyspaces that no longer exist
+        std::unordered_map<std::string, bool> live_files;
+        for (const auto& entry : entries) {
+            live_files[keyspaceFileName(entry.name, entry.generation)] = true;
+        }
+        for (const auto& file : std::filesystem::directory_iterator(dir)) {
+            if (file.path().extension() == ".vks" && live_files.count(file.path().filename().string()) == 0) {
+                std::filesystem::remove(file.path());
+            }
+        }
+        spdlog::info("Saved {} keyspaces of VectorStore: {} to {}", entries.size(), vector_store_name, directory);
+    }
+
+    // Load pending keyspaces with a non-zero prewarm priority on a background
+    // thread, highest priority first. Lookups of other keyspaces are not blocked.
+    void startPrewarm() {
+        stopPrewarm();
+
+        std::vector<std::shared_ptr<PendingKeyspace>> order;
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            for (const auto& [name, slot] : pending_keyspaces) {
+                if (slot->entry.prewarm_priority > 0) {
+                    order.push_back(slot);
+                }
+            }
+        }
+        std::sort(order.begin(), order.end(),
+            [](const auto& a, const auto& b) {
+                return a->entry.prewarm_priority > b->entry.prewarm_priority;
+            }
+        );
+
+        prewarm_thread = std::thread([this, order]() {
+            for (const auto& slot : order) {
+                if (stop_prewarm) {
+                    break;
+                }
+                try {
+                    loadPendingKeyspace(slot);
+                } catch (const std::exception& e) {
+                    spdlog::error("Failed to prewarm keyspace {}: {}", slot->entry.name, e.what());
+                }
+            }
+        });
+    }
 };
 
 #endif // VECTOR_STORE_HPP 
\ No newline at end of file
@@ -0,0 +1,62 @@
+#ifndef VISITED_TABLE_HPP
+#define VISITED_TABLE_HPP
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "prefetch.hpp"
+
+// Visited set for graph traversals, reused by every query on a thread.
+//
+// Each node has a slot holding the epoch of the last query that visited it.
+// Starting a query bumps the epoch, which forgets every earlier visit without
+// touching the slots, and a lookup is one read of one small slot. Epochs are
+// 16 bits to keep the table small at large node counts; when they wrap, the
+// table is zeroed once every 65535 queries.
+
+class VisitedTable {
+private:
+    std::vector<uint16_t> epochs;
+    uint16_t current = 0;
+
+public:
+    // Start a traversal over nodes [0, nodes)
+    void begin(size_t nodes) {
+        if (epochs.size() < nodes) {
+            epochs.resize(nodes, 0);  // new slots hold epoch 0, which is never current
+        }
+        if (++current == 0) {
+            std::fill(epochs.begin(), epochs.end(), 0);
+            current = 1;
+        }
+    }
+
+    // Mark `node` visited; false if this traversal already visited it
+    bool visit(size_t node) {
+        if (epochs[node] == current) {
+            return false;
+        }
+        epochs[node] = current;
+        return true;
+    }
+
+    bool visited(size_t node) const { return epochs[node] == current; }
+
+    // Hint that `node` is about to be tested
+    void prefetch(size_t node) const {
+        if (node < epochs.size()) {
+            prefetchRead(&epochs[node]);
+        }
+    }
+
+    size_t capacity() const { return epochs.size(); }
+};
+
+// The calling thread's table. One traversal at a time per thread.
+inline VisitedTable& threadVisitedTable() {
+    thread_local VisitedTable table;
+    return table;
+}
+
+#endif // VISITED_TABLE_HPP
@@ -0,0 +1,221 @@
+#ifndef WORKLOAD_TRACE_HPP
+#define WORKLOAD_TRACE_HPP
+
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "keyspace_spec.hpp"
+#include "storage_format.hpp"
+
+// Compact binary trace of the operations a VectorStore receives, for replaying
+// production traffic against another build (see trace_replay.cpp).
+//
+// Layout: u32 magic, u32 version, then events back to back. Every event is
+//   u8 type, u64 nanoseconds since the trace started, u32 keyspace id
+// followed by type-specific fields. A keyspace is introduced once by a
+// DefineKeyspace event (name and spec) before any event refers to its id.
+
+constexpr uint32_t kTraceMagic = 0x52545356;  // "VSTR"
+constexpr uint32_t kTraceFormatVersion = 1;
+
+enum class TraceEventType : uint8_t {
+    DefineKeyspace = 0,   // name, spec
+    SearchNearest = 1,    // query
+    SearchThreshold = 2,  // threshold, query
+    Insert = 3,           // values
+    Remove = 4,           // index
+    Update = 5,           // index, values
+    Upsert = 6,           // index, values
+};
+
+struct TraceEvent {
+    TraceEventType type = TraceEventType::Insert;
+    uint64_t timestamp_ns = 0;
+    uint32_t keyspace = 0;
+    std::string name;            // DefineKeyspace
+    KeyspaceSpec spec;           // DefineKeyspace
+    double threshold = 0.0;      // SearchThreshold
+    uint64_t index = 0;          // Remove, Update, Upsert
+    std::vector<double> values;  // query or row
+};
+
+// Appends events to a trace file. Shared by every keyspace of a store while
+// tracing is on; each event is one buffered write under a mutex.
+class TraceRecorder {
+private:
+    std::ofstream out;
+    std::string path;
+    std::mutex mtx;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    uint32_t next_keyspace_id = 0;
+    uint64_t event_count = 0;
+
+    // Must hold `mtx`
+    void writeHeader(TraceEventType type, uint32_t keyspace) {
+        uint64_t now = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - start).count());
+        writePod(out, static_cast<uint8_t>(type));
+        writePod(out, now);
+        writePod(out, keyspace);
+        ++event_count;
+    }
+
+    // Must hold `mtx`
+    void writeValues(const double* values, size_t count) {
+        writePod<uint32_t>(out, static_cast<uint32_t>(count));
+        out.write(reinterpret_cast<const char*>(values), count * sizeof(double));
+    }
+
+public:
+    explicit TraceRecorder(const std::string& path) : out(path, std::ios::binary | std::ios::trunc), path(path) {
+        if (!out) {
+            throw std::runtime_error("Failed to open trace file for writing: " + path);
+        }
+        writePod(out, kTraceMagic);
+        writePod(out, kTraceFormatVersion);
+    }
+
+    ~TraceRecorder() {
+        out.flush();
+    }
+
+    const std::string& getPath() const { return path; }
+
+    uint64_t eventCount() {
+        std::lock_guard<std::mutex> lock(mtx);
+        return event_count;
+    }
+
+    // Introduce a keyspace and return the id its events are recorded under
+    uint32_t defineKeyspace(const std::string& name, const KeyspaceSpec& spec) {
+        std::lock_guard<std::mutex> lock(mtx);
+        uint32_t id = next_keyspace_id++;
+        writeHeader(TraceEventType::DefineKeyspace, id);
+        writeString(out, name);
+        writeSpec(out, spec);
+        return id;
+    }
+
+    void recordSearch(uint32_t keyspace, const double* query, size_t dimension) {
+        std::lock_guard<std::mutex> lock(mtx);
+        writeHeader(TraceEventType::SearchNearest, keyspace);
+        writeValues(query, dimension);
+    }
+
+    void recordThresholdSearch(uint32_t keyspace, const double* query, size_t dimension, double threshold) {
+        std::lock_guard<std::mutex> lock(mtx);
+        writeHeader(TraceEventType::SearchThreshold, keyspace);
+        writePod(out, threshold);
+        writeValues(query, dimension);
+    }
+
+    void recordInsert(uint32_t keyspace, const double* values, size_t dimension) {
+        std::lock_guard<std::mutex> lock(mtx);
+        writeHeader(TraceEventType::Insert, keyspace);
+        writeValues(values, dimension);
+    }
+
+    void recordRemove(uint32_t keyspace, uint64_t index) {
+        std::lock_guard<std::mutex> lock(mtx);
+        writeHeader(TraceEventType::Remove, keyspace);
+        writePod(out, index);
+    }
+
+    // `type` is Update or Upsert
+    void recordUpdate(uint32_t keyspace, TraceEventType type, uint64_t index, const double* values, size_t dimension) {
+        std::lock_guard<std::mutex> lock(mtx);
+        writeHeader(type, keyspace);
+        writePod(out, index);
+        writeValues(values, dimension);
+    }
+
+    void flush() {
+        std::lock_guard<std::mutex> lock(mtx);
+        out.flush();
+    }
+};
+
+// A keyspace's connection to the active recorder
+struct TraceBinding {
+    std::shared_ptr<TraceRecorder> recorder;
+    uint32_t keyspace_id;
+};
+
+// Reads a trace file event by event
+class TraceReader {
+private:
+    std::ifstream in;
+
+    std::vector<double> readValues() {
+        uint32_t count = readPod<uint32_t>(in);
+        std::vector<double> values(count);
+        if (!in.read(reinterpret_cast<char*>(values.data()), count * sizeof(double))) {
+            throw std::runtime_error("Truncated trace event");
+        }
+        return values;
+    }
+
+public:
+    explicit TraceReader(const std::string& path) : in(path, std::ios::binary) {
+        if (!in) {
+            throw std::runtime_error("Failed to open trace file: " + path);
+        }
+        if (readPod<uint32_t>(in) != kTraceMagic) {
+            throw std::runtime_error("Not a workload trace: " + path);
+        }
+        if (readPod<uint32_t>(in) != kTraceFormatVersion) {
+            throw std::runtime_error("Unsupported trace version: " + path);
+        }
+    }
+
+    // Read the next event; false at the end of the trace. A trace cut off
+    // mid-event (the recording process died) ends at the last whole event.
+    bool next(TraceEvent& event) {
+        if (in.peek() == std::char_traits<char>::eof()) {
+            return false;
+        }
+        try {
+            event = TraceEvent();
+            event.type = static_cast<TraceEventType>(readPod<uint8_t>(in));
+            event.timestamp_ns = readPod<uint64_t>(in);
+            event.keyspace = readPod<uint32_t>(in);
+            switch (event.type) {
+                case TraceEventType::DefineKeyspace:
+                    event.name = readString(in);
+                    event.spec = readSpec(in);
+                    break;
+                case TraceEventType::SearchNearest:
+                case TraceEventType::Insert:
+                    event.values = readValues();
+                    break;
+                case TraceEventType::SearchThreshold:
+                    event.threshold = readPod<double>(in);
+                    event.values = readValues();
+                    break;
+                case TraceEventType::Remove:
+                    event.index = readPod<uint64_t>(in);
+                    break;
+                case TraceEventType::Update:
+                case TraceEventType::Upsert:
+                    event.index = readPod<uint64_t>(in);
+                    event.values = readValues();
+                    break;
+                default:
+                    throw std::runtime_error("Unknown trace event type");
+            }
+        } catch (const std::runtime_error&) {
+            if (in.eof()) {
+                return false;
+            }
+            throw;
+        }
+        return true;
+    }
+};
+
+#endif // WORKLOAD_TRACE_HPP
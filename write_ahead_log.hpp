@@ -0,0 +1,480 @@
+#ifndef WRITE_AHEAD_LOG_HPP
+#define WRITE_AHEAD_LOG_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <fcntl.h>
+#include <unistd.h>
+#include <spdlog/spdlog.h>
+#include "crc32c.hpp"
+#include "storage_format.hpp"
+
+// Operations recorded in the write-ahead log
+enum class WalOp : uint8_t {
+    CreateKeyspace = 1,
+    DropKeyspace = 2,
+    AddVector = 3,
+    RemoveVector = 4,
+    CloneKeyspace = 5,
+    SetAlias = 6,
+    RemoveAlias = 7,
+    UpdateVector = 8,
+    WriteBatch = 9,
+};
+
+// One operation of a WriteBatch record: AddVector, RemoveVector or UpdateVector
+struct WalBatchEntry {
+    WalOp op = WalOp::AddVector;
+    uint64_t index = 0;  // row the operation applied to, as in WalRecord
+};
+
+// Where a record sits in the log: its segment and the byte offset of its frame
+struct WalLocation {
+    uint64_t segment_id = 0;
+    uint64_t offset = 0;
+};
+
+struct WalRecord {
+    uint64_t lsn = 0;          // log sequence number, assigned by WriteAheadLog::append
+    WalOp op = WalOp::AddVector;
+    std::string keyspace;      // keyspace name, or the alias name for alias records
+    std::string source;        // CloneKeyspace: keyspace that was cloned; SetAlias: alias target
+    KeyspaceSpec spec;         // CreateKeyspace
+    uint64_t index = 0;        // row the mutation applied to (for AddVector, the new row)
+    uint64_t sequence = 0;     // change sequence of the mutation; WriteBatch: of its first entry
+    std::vector<double> values;  // AddVector, UpdateVector; WriteBatch: rows of its entries, in order
+    std::vector<WalBatchEntry> entries;  // WriteBatch
+    WalLocation location;      // set by WriteAheadLog::append and readAll; not logged
+
+    static WalRecord createKeyspace(const std::string& keyspace, const KeyspaceSpec& spec) {
+        WalRecord record;
+        record.op = WalOp::CreateKeyspace;
+        record.keyspace = keyspace;
+        record.spec = spec;
+        return record;
+    }
+
+    static WalRecord dropKeyspace(const std::string& keyspace) {
+        WalRecord record;
+        record.op = WalOp::DropKeyspace;
+        record.keyspace = keyspace;
+        return record;
+    }
+
+    static WalRecord cloneKeyspace(const std::string& keyspace, const std::string& source) {
+        WalRecord record;
+        record.op = WalOp::CloneKeyspace;
+        record.keyspace = keyspace;
+        record.source = source;
+        return record;
+    }
+
+    static WalRecord setAlias(const std::string& alias, const std::string& target) {
+        WalRecord record;
+        record.op = WalOp::SetAlias;
+        record.keyspace = alias;
+        record.source = target;
+        return record;
+    }
+
+    static WalRecord removeAlias(const std::string& alias) {
+        WalRecord record;
+        record.op = WalOp::RemoveAlias;
+        record.keyspace = alias;
+        return record;
+    }
+
+    static WalRecord addVector(const std::string& keyspace, const double* values, size_t dimension) {
+        WalRecord record;
+        record.op = WalOp::AddVector;
+        record.keyspace = keyspace;
+        record.values.assign(values, values + dimension);
+        return record;
+    }
+
+    static WalRecord removeVector(const std::string& keyspace, uint64_t index) {
+        WalRecord record;
+        record.op = WalOp::RemoveVector;
+        record.keyspace = keyspace;
+        record.index = index;
+        return record;
+    }
+
+    static WalRecord writeBatch(const std::string& keyspace, std::vector<WalBatchEntry> entries,
+                                std::vector<double> values) {
+        WalRecord record;
+        record.op = WalOp::WriteBatch;
+        record.keyspace = keyspace;
+        record.entries = std::move(entries);
+        record.values = std::move(values);
+        return record;
+    }
+
+    static WalRecord updateVector(const std::string& keyspace, uint64_t index, const double* values, size_t dimension) {
+        WalRecord record;
+        record.op = WalOp::UpdateVector;
+        record.keyspace = keyspace;
+        record.index = index;
+        record.values.assign(values, values + dimension);
+        return record;
+    }
+};
+
+// When an appended record counts as written
+enum class WalSyncMode {
+    Flush,  // handed to the OS: survives a process crash, not an OS crash or power loss
+    Sync,   // fdatasync'ed to the device: survives an OS crash or power loss
+};
+
+// Append-only log of keyspace mutations, split into numbered segment files
+// (wal_<id>.log). Every record is framed as [u32 length][u32 crc32c][payload]
+// so a torn write at the tail of a segment is detected and ignored on replay.
+//
+// In Sync mode appends use group commit: a record is written under the log
+// lock, then one waiting appender syncs the segment on behalf of every record
+// written so far while the others wait for it, so concurrent writers share
+// one fdatasync instead of queueing one each. Callers that order records
+// under a lock of their own write() under it and waitDurable() after
+// releasing it, so that they batch as well.
+class WriteAheadLog {
+private:
+    // An open segment file. Shared so that a sync in progress keeps the
+    // descriptor open across a rotation.
+    struct Segment {
+        int fd;
+        std::string path;
+
+        explicit Segment(std::string segment_path) : path(std::move(segment_path)) {
+            fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+            if (fd < 0) {
+                throw std::runtime_error("Failed to open WAL segment: " + path + ": " + std::strerror(errno));
+            }
+        }
+        ~Segment() { ::close(fd); }
+        Segment(const Segment&) = delete;
+        Segment& operator=(const Segment&) = delete;
+
+        void sync() const {
+            if (::fdatasync(fd) != 0) {
+                throw std::runtime_error("Failed to sync WAL segment: " + path + ": " + std::strerror(errno));
+            }
+        }
+    };
+
+    std::string directory;
+    std::shared_ptr<Segment> segment;
+    uint64_t segment_id;
+    uint64_t segment_bytes = 0;  // current size of the open segment
+    uint64_t next_lsn;
+    std::mutex mtx;  // guards segment, segment_id and next_lsn
+    std::atomic<WalSyncMode> sync_mode{WalSyncMode::Sync};
+
+    // Group commit state
+    std::mutex sync_mtx;
+    std::condition_variable sync_done;
+    uint64_t durable_lsn = 0;  // every record up to here has been synced
+    bool syncing = false;      // an appender is running fdatasync
+
+    void openSegment() {
+        segment = std::make_shared<Segment>(segmentPath(directory, segment_id));
+        off_t size = ::lseek(segment->fd, 0, SEEK_END);
+        segment_bytes = size > 0 ? static_cast<uint64_t>(size) : 0;
+    }
+
+    // Read the frame at the current position of `in`, a segment of
+    // `segment_size` bytes. False at the end of the segment or at a torn
+    // record; a garbage length is rejected before anything is allocated.
+    static bool readFrame(std::istream& in, uint64_t segment_size, std::string& payload) {
+        uint32_t length, checksum;
+        if (!in.read(reinterpret_cast<char*>(&length), sizeof(length)) ||
+            !in.read(reinterpret_cast<char*>(&checksum), sizeof(checksum))) {
+            return false;
+        }
+        std::streamoff position = in.tellg();
+        if (position < 0 || length > segment_size - std::min<uint64_t>(segment_size, position)) {
+            return false;
+        }
+        payload.resize(length);
+        return in.read(&payload[0], length) && crc32c(payload.data(), length) == checksum;
+    }
+
+    void writeAll(const char* data, size_t size) {
+        while (size > 0) {
+            ssize_t written = ::write(segment->fd, data, size);
+            if (written < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                throw std::runtime_error("Failed to append to WAL segment: " + segment->path + ": " +
+                                         std::strerror(errno));
+            }
+            data += written;
+            size -= static_cast<size_t>(written);
+        }
+    }
+
+    // Cut the partial frame a failed write may have left at the end of the
+    // segment, so that records appended after it stay readable. If the
+    // segment cannot be truncated, later records go to a fresh segment.
+    void discardPartialWrite() {
+        if (::ftruncate(segment->fd, static_cast<off_t>(segment_bytes)) == 0) {
+            return;
+        }
+        spdlog::error("Failed to truncate WAL segment: {}: {}", segment->path, std::strerror(errno));
+        try {
+            auto next = std::make_shared<Segment>(segmentPath(directory, segment_id + 1));
+            segment = std::move(next);
+            segment_id++;
+            segment_bytes = 0;
+        } catch (const std::exception& e) {
+            spdlog::error("Failed to rotate WAL after a failed append: {}", e.what());
+        }
+    }
+
+    static std::string encode(const WalRecord& record) {
+        std::ostringstream payload;
+        writePod(payload, record.lsn);
+        writePod(payload, static_cast<uint8_t>(record.op));
+        writeString(payload, record.keyspace);
+        writeString(payload, record.source);
+        writeSpec(payload, record.spec);
+        writePod(payload, record.index);
+        writePod(payload, record.sequence);
+        writePod<uint64_t>(payload, record.values.size());
+        payload.write(reinterpret_cast<const char*>(record.values.data()), record.values.size() * sizeof(double));
+        writePod<uint64_t>(payload, record.entries.size());
+        for (const WalBatchEntry& entry : record.entries) {
+            writePod(payload, static_cast<uint8_t>(entry.op));
+            writePod(payload, entry.index);
+        }
+        return payload.str();
+    }
+
+    static WalRecord decode(const std::string& bytes) {
+        std::istringstream payload(bytes);
+        WalRecord record;
+        record.lsn = readPod<uint64_t>(payload);
+        record.op = static_cast<WalOp>(readPod<uint8_t>(payload));
+        record.keyspace = readString(payload);
+        record.source = readString(payload);
+        record.spec = readSpec(payload);
+        record.index = readPod<uint64_t>(payload);
+        record.sequence = readPod<uint64_t>(payload);
+        uint64_t count = readPod<uint64_t>(payload);
+        record.values.resize(count);
+        if (!payload.read(reinterpret_cast<char*>(record.values.data()), count * sizeof(double))) {
+            throw std::runtime_error("Truncated WAL record");
+        }
+        record.entries.resize(readPod<uint64_t>(payload));
+        for (WalBatchEntry& entry : record.entries) {
+            entry.op = static_cast<WalOp>(readPod<uint8_t>(payload));
+            entry.index = readPod<uint64_t>(payload);
+        }
+        return record;
+    }
+
+public:
+    // Start a new segment in `directory`; the next appended record gets `first_lsn`
+    WriteAheadLog(const std::string& directory, uint64_t segment_id, uint64_t first_lsn)
+        : directory(directory), segment_id(segment_id), next_lsn(first_lsn), durable_lsn(first_lsn - 1) {
+        openSegment();
+    }
+
+    const std::string& getDirectory() const { return directory; }
+
+    WalSyncMode getSyncMode() const { return sync_mode.load(std::memory_order_relaxed); }
+    void setSyncMode(WalSyncMode mode) { sync_mode.store(mode, std::memory_order_relaxed); }
+
+    static std::string segmentPath(const std::string& directory, uint64_t segment_id) {
+        char name[32];
+        std::snprintf(name, sizeof(name), "wal_%08llu.log", static_cast<unsigned long long>(segment_id));
+        return (std::filesystem::path(directory) / name).string();
+    }
+
+    // Segment ids present in `directory`, oldest first
+    static std::vector<uint64_t> listSegments(const std::string& directory) {
+        std::vector<uint64_t> ids;
+        if (!std::filesystem::exists(directory)) {
+            return ids;
+        }
+        for (const auto& file : std::filesystem::directory_iterator(directory)) {
+            std::string name = file.path().filename().string();
+            if (name.size() == 16 && name.compare(0, 4, "wal_") == 0 && name.compare(12, 4, ".log") == 0) {
+                ids.push_back(std::stoull(name.substr(4, 8)));
+            }
+        }
+        std::sort(ids.begin(), ids.end());
+        return ids;
+    }
+
+    // Read every intact record from all segments in log order
+    static std::vector<WalRecord> readAll(const std::string& directory) {
+        std::vector<WalRecord> records;
+        for (uint64_t id : listSegments(directory)) {
+            std::string path = segmentPath(directory, id);
+            std::ifstream in(path, std::ios::binary);
+            uint64_t segment_size = std::filesystem::file_size(path);
+            std::string payload;
+            while (true) {
+                uint64_t offset = static_cast<uint64_t>(in.tellg());
+                if (in.peek() == std::char_traits<char>::eof()) {
+                    break;
+                }
+                if (!readFrame(in, segment_size, payload)) {
+                    spdlog::warn("Ignoring torn tail of WAL segment {}", path);
+                    break;
+                }
+                records.push_back(decode(payload));
+                records.back().location = {id, offset};
+            }
+        }
+        return records;
+    }
+
+    // Reads single records by location, keeping the last segment it read open
+    // so that a run of records from one segment costs one open
+    class Reader {
+    private:
+        std::string directory;
+        std::ifstream in;
+        uint64_t open_segment = 0;
+        bool is_open = false;
+
+    public:
+        explicit Reader(std::string directory) : directory(std::move(directory)) {}
+
+        // False if the segment was removed or the record is not intact
+        bool read(const WalLocation& location, WalRecord& record) {
+            if (!is_open || open_segment != location.segment_id) {
+                in.close();
+                in.clear();
+                in.open(segmentPath(directory, location.segment_id), std::ios::binary);
+                is_open = static_cast<bool>(in);
+                open_segment = location.segment_id;
+                if (!is_open) {
+                    return false;
+                }
+            }
+            // The segment may still be growing, so its size is taken per read
+            in.clear();
+            in.seekg(0, std::ios::end);
+            std::streamoff segment_size = in.tellg();
+            in.seekg(static_cast<std::streamoff>(location.offset));
+            std::string payload;
+            if (segment_size < 0 || !readFrame(in, static_cast<uint64_t>(segment_size), payload)) {
+                return false;
+            }
+            record = decode(payload);
+            record.location = location;
+            return true;
+        }
+    };
+
+    // Write a record, assigning and returning its LSN and setting its
+    // location, without waiting for it to be durable
+    uint64_t write(WalRecord& record) {
+        std::lock_guard<std::mutex> lock(mtx);
+        record.lsn = next_lsn;
+        std::string payload = encode(record);
+        uint32_t length = static_cast<uint32_t>(payload.size());
+        uint32_t checksum = crc32c(payload.data(), payload.size());
+        std::string frame(sizeof(length) + sizeof(checksum), '\0');
+        std::memcpy(&frame[0], &length, sizeof(length));
+        std::memcpy(&frame[sizeof(length)], &checksum, sizeof(checksum));
+        frame += payload;
+        try {
+            writeAll(frame.data(), frame.size());
+        } catch (...) {
+            discardPartialWrite();
+            throw;
+        }
+        record.location = {segment_id, segment_bytes};
+        segment_bytes += frame.size();
+        return next_lsn++;
+    }
+
+    // Block until the record with `lsn` is as durable as the sync mode asks
+    // for. In Sync mode this syncs the segment unless another appender is
+    // already doing so.
+    void waitDurable(uint64_t lsn) {
+        if (getSyncMode() != WalSyncMode::Sync) {
+            return;
+        }
+        std::unique_lock<std::mutex> lock(sync_mtx);
+        while (durable_lsn < lsn) {
+            if (syncing) {
+                sync_done.wait(lock);
+                continue;
+            }
+            syncing = true;
+            lock.unlock();
+            std::shared_ptr<Segment> target;
+            uint64_t covered;
+            {
+                std::lock_guard<std::mutex> log_lock(mtx);
+                target = segment;
+                covered = next_lsn - 1;
+            }
+            try {
+                target->sync();
+            } catch (...) {
+                lock.lock();
+                syncing = false;
+                sync_done.notify_all();
+                throw;
+            }
+            lock.lock();
+            syncing = false;
+            durable_lsn = std::max(durable_lsn, covered);
+            sync_done.notify_all();
+        }
+    }
+
+    // Append a record, assigning and returning its LSN and setting its
+    // location. Returns once the record is as durable as the sync mode asks for.
+    uint64_t append(WalRecord& record) {
+        uint64_t lsn = write(record);
+        waitDurable(lsn);
+        return lsn;
+    }
+
+    // Switch appends to a fresh segment; returns the id of the segment just closed
+    uint64_t rotate() {
+        std::lock_guard<std::mutex> lock(mtx);
+        // Syncs that start after this point only see the new segment, so
+        // records still unsynced in the old one are synced here
+        if (getSyncMode() == WalSyncMode::Sync) {
+            segment->sync();
+            std::lock_guard<std::mutex> sync_lock(sync_mtx);
+            durable_lsn = std::max(durable_lsn, next_lsn - 1);
+            sync_done.notify_all();
+        }
+        uint64_t closed = segment_id++;
+        openSegment();
+        return closed;
+    }
+
+    // Delete segments whose records are all covered by a checkpoint
+    void removeSegmentsUpTo(uint64_t last_segment_id) {
+        for (uint64_t id : listSegments(directory)) {
+            if (id <= last_segment_id) {
+                std::filesystem::remove(segmentPath(directory, id));
+            }
+        }
+    }
+};
+
+#endif // WRITE_AHEAD_LOG_HPP